@@ -0,0 +1,219 @@
+// Nesting stress: generated inputs nested `depth` levels deep (a million by
+// default), run through every analysis entry point. Each one must finish
+// without exhausting the call stack and produce the result a shallow input
+// would; a mismatch is reported and makes the exit status non-zero.
+//
+// Usage: bench_depth [depth]   (default 1000000)
+//   chain   `1 + 1 + ... + 1`, a left-leaning binary_expression chain
+//   parens  `((...(x)...))`
+//   blocks  nested `if (c) { ... }` around a free(), for the flow graph
+//   calls   `f0` returning `f1()` returning ... `f<depth>()`, which returns 42
+//   updates `depth` increments of a local before a test of its value
+//   reads   the same, then `std::cin >> v` and `read((v))` writing it unseen
+#include "../patterns/analyzer.h"
+#include "../patterns/callgraph.h"
+#include "../patterns/constant_evaluator.h"
+#include "../patterns/functions.h"
+#include "../patterns/grammar.h"
+#include "../patterns/nodeprinter.h"
+#include "../patterns/returnv.h"
+#include "../patterns/source.h"
+#include "../patterns/visitor.h"
+#include "../patterns/xrefindex.h"
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+
+static std::string chain(int depth) {
+    std::string code = "int chain() {\n    return ";
+    for (int i = 1; i < depth; i++) code += "1 + ";
+    return code + "1;\n}\n";
+}
+
+static std::string parens(int depth) {
+    return "int parens() {\n    return " + std::string(depth, '(') + "x" + std::string(depth, ')') + ";\n}\n";
+}
+
+static std::string blocks(int depth) {
+    std::string code = "void blocks(int c) {\n    int *p = (int *)malloc(4);\n";
+    for (int i = 0; i < depth; i++) code += "if (c) {\n";
+    code += "free(p);\n";
+    for (int i = 0; i < depth; i++) code += "}\n";
+    return code + "}\n";
+}
+
+// `depth` updates of one local: constant propagation must carry its value
+// through all of them to prune the early return. `reads` adds writes through
+// references after them, which must keep it.
+static std::string updates(int depth, const char *name = "updates", const char *reads = "") {
+    std::string code = std::string("int ") + name + "() {\n    int v = 0;\n";
+    for (int i = 0; i < depth; i++) code += "    v += 1;\n";
+    return code + reads + "    if (v != " + std::to_string(depth) + ") return 0;\n    return 1;\n}\n";
+}
+
+// A chain of `depth` forwarding calls, defined callee first so that the
+// call graph gets no help from source order.
+static std::string calls(int depth) {
+    std::string code = "int f" + std::to_string(depth) + "() { return 42; }\n";
+    for (int i = depth - 1; i >= 0; i--) {
+        code += "int f" + std::to_string(i) + "() { return f" + std::to_string(i + 1) + "(); }\n";
+    }
+    return code;
+}
+
+// Discards output but still makes the printer format every line.
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return c; }
+    std::streamsize xsputn(const char *, std::streamsize n) override { return n; }
+};
+
+// Value of the function's (only) return statement.
+static TSNode returned_expression(TSNode root) {
+    TSNode found = {};
+    TreeWalker walker;
+    walker.walk(root, [&](TSNode node, uint32_t) {
+        if (ts_node_symbol(node) != cpp_grammar().return_statement) return Visit::Continue;
+        found = ts_node_named_child(node, 0);
+        return Visit::Stop;
+    });
+    return found;
+}
+
+template <typename Fn>
+static double seconds(Fn &&fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static int failures = 0;
+
+static void report(const char *input, const char *operation, double time, bool ok) {
+    std::cout << std::left << std::setw(8) << input << std::setw(24) << operation << std::right << std::fixed
+              << std::setprecision(3) << std::setw(10) << time << (ok ? "  ok" : "  MISMATCH") << "\n";
+    failures += !ok;
+}
+
+int main(int argc, char **argv) {
+    int depth = argc > 1 ? std::max(1, std::atoi(argv[1])) : 1000000;
+
+    TSParser *parser = ts_parser_new();
+    ts_parser_set_language(parser, tree_sitter_cpp());
+    NullBuffer discard;
+    std::ostream null_out(&discard);
+    std::cout << std::left << std::setw(8) << "input" << std::setw(24) << "operation" << std::right
+              << std::setw(10) << "seconds" << "  depth " << depth << "\n";
+
+    {
+        std::string code = chain(depth);
+        TSTree *tree = nullptr;
+        report("chain", "parse", seconds([&] { tree = parse_source(parser, nullptr, code); }), tree != nullptr);
+        TSNode root = ts_tree_root_node(tree);
+        TSNode expression = returned_expression(root);
+
+        int value = 0;
+        report("chain", "evaluate_expression",
+               seconds([&] { value = evaluate_expression(expression, code, {}); }), value == depth);
+        // Every operator node folded once is memoized, so the left operand
+        // (the whole chain but one term) comes back from the table.
+        ConstantEvaluator evaluator(code);
+        evaluator.evaluate(expression);
+        ConstantValue left;
+        report("chain", "evaluate (memoized)",
+               seconds([&] { left = evaluator.evaluate(ts_node_child_by_field_id(expression, cpp_grammar().field_left)); }),
+               left.known() && left.as_signed() == depth - 1);
+        std::vector<std::string> returns;
+        report("chain", "collect_return_values", seconds([&] { returns = collect_return_values(root, code, "chain"); }),
+               returns.size() == 1 && returns[0] == node_text(expression, code));
+        std::vector<FunctionInfo> functions;
+        report("chain", "collect_functions", seconds([&] { collect_functions(root, code, functions); }),
+               functions.size() == 1 && functions[0].name == "chain");
+        report("chain", "print_node", seconds([&] { print_node(root, code, 0, null_out); }), true);
+        AnalysisResult result;
+        report("chain", "analyze_code (+parse)", seconds([&] { analyze_code(parser, code, result); }),
+               result.warnings.empty() && result.incomplete.empty());
+        ts_tree_delete(tree);
+    }
+
+    {
+        std::string code = parens(depth);
+        TSTree *tree = parse_source(parser, nullptr, code);
+        TSNode expression = returned_expression(ts_tree_root_node(tree));
+        std::string_view name;
+        report("parens", "find_identifier", seconds([&] { name = find_identifier(expression, code); }), name == "x");
+        int value = 0;
+        report("parens", "evaluate_expression",
+               seconds([&] { value = evaluate_expression(expression, code, {{"x", 7}}); }), value == 7);
+        report("parens", "print_node", seconds([&] { print_node(expression, code, 0, null_out); }), true);
+        ts_tree_delete(tree);
+    }
+
+    {
+        std::string code = updates(depth);
+        TSTree *tree = parse_source(parser, nullptr, code);
+        std::vector<std::string> returns;
+        report("updates", "collect_return_values",
+               seconds([&] { returns = collect_return_values(ts_tree_root_node(tree), code, "updates"); }),
+               returns.size() == 1 && returns[0] == "1");
+        std::vector<ReturnSummary> summaries;
+        report("updates", "summarize_return_values",
+               seconds([&] { summaries = summarize_return_values(ts_tree_root_node(tree), code); }),
+               summaries.size() == 1 && summaries[0].name == "updates" && summaries[0].value == "1");
+        ts_tree_delete(tree);
+    }
+
+    for (const char *read : {"    std::cin >> v;\n", "    read((v));\n", "    read(c ? v : w);\n"}) {
+        std::string code = updates(depth, "reads", read);
+        TSTree *tree = parse_source(parser, nullptr, code);
+        std::vector<std::string> returns;
+        report("reads", "collect_return_values",
+               seconds([&] { returns = collect_return_values(ts_tree_root_node(tree), code, "reads"); }),
+               returns.size() == 1 && returns[0] == "0");
+        std::vector<ReturnSummary> summaries;
+        report("reads", "summarize_return_values",
+               seconds([&] { summaries = summarize_return_values(ts_tree_root_node(tree), code); }),
+               summaries.size() == 1 && summaries[0].value == "0");
+        ts_tree_delete(tree);
+    }
+
+    {
+        std::string code = calls(depth);
+        TSTree *tree = parse_source(parser, nullptr, code);
+        std::vector<ReturnSummary> summaries = summarize_return_values(ts_tree_root_node(tree), code);
+        CallGraph graph;
+        graph.set_file("calls", std::move(summaries));
+        report("calls", "CallGraph::solve", seconds([&] { graph.solve(); }),
+               graph.find("f0") && constant_text(graph.find("f0")->constant) == "42" &&
+                   graph.levels() == static_cast<size_t>(depth) + 1);
+        std::vector<XrefEntry> entries;
+        report("calls", "collect_xrefs", seconds([&] { entries = collect_xrefs(ts_tree_root_node(tree), code); }),
+               entries.size() == 2 * static_cast<size_t>(depth) + 1);
+        std::string index_path = (std::filesystem::temp_directory_path() / "bench_depth.xref").string();
+        XrefIndexBuilder builder;
+        builder.set_file("calls", content_hash(code), std::move(entries));
+        report("calls", "XrefIndexBuilder::write", seconds([&] { builder.write(index_path); }), true);
+        // f1 is defined once and called once, from f0.
+        XrefIndex index;
+        size_t found = 0;
+        report("calls", "XrefIndex open + lookup", seconds([&] {
+                   index = XrefIndex(index_path);
+                   auto records = index.lookup("f1");
+                   found = static_cast<size_t>(records.second - records.first);
+               }),
+               found == 2);
+        std::filesystem::remove(index_path);
+        ts_tree_delete(tree);
+    }
+
+    {
+        // p is freed on one path only, so exactly one leak is expected.
+        std::string code = blocks(depth);
+        AnalysisResult result;
+        report("blocks", "analyze_code (+parse)", seconds([&] { analyze_code(parser, code, result); }),
+               result.warnings.size() == 1 && result.warnings[0].rfind("Potential memory leak: Variable `p`", 0) == 0);
+    }
+
+    ts_parser_delete(parser);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,127 @@
+// Node-dispatch benchmark: walks one large translation unit with the old
+// `std::string type = ts_node_type(node)` + if/else chain and with the
+// symbol-indexed handler table used by analyze_code, and reports nodes/second
+// for both.
+//
+// Usage: bench_dispatch [source.cpp] [repetitions]
+// Without a file a synthetic translation unit of ~200k lines is generated.
+#include "../patterns/analyzer.h"
+#include "../patterns/grammar.h"
+#include <chrono>
+#include <fstream>
+#include <string>
+
+static std::string synthetic_unit(int functions) {
+    std::ostringstream out;
+    for (int i = 0; i < functions; i++) {
+        out << "int f" << i << "(int n, int *table) {\n"
+            << "    int *p = (int *)malloc(sizeof(int) * n);\n"
+            << "    int *q = new int[n];\n"
+            << "    for (int k = 0; k < n; k++) { p[k] = table[k] + k * 3; q[k] = p[k] - 1; }\n"
+            << "    std::sort(q, q + n);\n"
+            << "    int r = n > 1 ? f" << i << "(n - 1, table) + q[0] : p[0];\n"
+            << "    free(p);\n"
+            << "    delete[] q;\n"
+            << "    return r;\n"
+            << "}\n";
+    }
+    return out.str();
+}
+
+static std::string read_source(const char *path) {
+    std::ifstream in(path, std::ios::binary);
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+// Pre-change dispatch: allocate the type name and compare it against every kind.
+static size_t walk_string_dispatch(TSNode root, size_t &matched) {
+    size_t visited = 0;
+    std::vector<TSNode> stack = {root};
+    while (!stack.empty()) {
+        TSNode node = stack.back();
+        stack.pop_back();
+        visited++;
+        std::string type = ts_node_type(node);
+        if (type == "init_declarator") matched++;
+        else if (type == "delete_expression") matched++;
+        else if (type == "call_expression") matched++;
+        else if (type == "assignment_expression") matched++;
+        else if (type == "function_declarator") matched++;
+        else if (type == "subscript_expression") matched++;
+        for (uint32_t i = 0; i < ts_node_child_count(node); i++) {
+            stack.push_back(ts_node_child(node, i));
+        }
+    }
+    return visited;
+}
+
+// Post-change dispatch: one ts_node_symbol and an indexed load per node.
+static size_t walk_symbol_dispatch(TSNode root, size_t &matched) {
+    using Counter = void (*)(size_t &);
+    static const SymbolTable<Counter> table = [] {
+        const CppGrammar &g = cpp_grammar();
+        SymbolTable<Counter> t(g.symbol_count);
+        Counter bump = [](size_t &n) { n++; };
+        for (TSSymbol s : {g.init_declarator, g.delete_expression, g.call_expression,
+                           g.assignment_expression, g.function_declarator, g.subscript_expression}) {
+            t.set(s, bump);
+        }
+        return t;
+    }();
+    size_t visited = 0;
+    std::vector<TSNode> stack = {root};
+    while (!stack.empty()) {
+        TSNode node = stack.back();
+        stack.pop_back();
+        visited++;
+        if (Counter handler = table.get(ts_node_symbol(node))) handler(matched);
+        for (uint32_t i = 0; i < ts_node_child_count(node); i++) {
+            stack.push_back(ts_node_child(node, i));
+        }
+    }
+    return visited;
+}
+
+template <typename Fn>
+static double seconds(Fn &&fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv) {
+    std::string code = argc > 1 ? read_source(argv[1]) : synthetic_unit(20000);
+    int repetitions = argc > 2 ? std::atoi(argv[2]) : 5;
+
+    TSParser *parser = ts_parser_new();
+    ts_parser_set_language(parser, tree_sitter_cpp());
+    TSTree *tree = ts_parser_parse_string(parser, nullptr, code.c_str(), code.size());
+    TSNode root = ts_tree_root_node(tree);
+
+    size_t nodes = 0, matched_string = 0, matched_symbol = 0;
+    double string_time = 0, symbol_time = 0, analyze_time = 0;
+    for (int r = 0; r < repetitions; r++) {
+        string_time += seconds([&] { nodes = walk_string_dispatch(root, matched_string); });
+        symbol_time += seconds([&] { walk_symbol_dispatch(root, matched_symbol); });
+        analyze_time += seconds([&] {
+            AnalysisResult result;
+            analyze_code(parser, code, result);
+        });
+    }
+
+    double total = static_cast<double>(nodes) * repetitions;
+    std::cout << "input: " << code.size() << " bytes, " << nodes << " nodes, " << repetitions << " repetitions\n";
+    std::cout << "string dispatch:  " << static_cast<uint64_t>(total / string_time) << " nodes/s\n";
+    std::cout << "symbol dispatch:  " << static_cast<uint64_t>(total / symbol_time) << " nodes/s\n";
+    std::cout << "analyze_code:     " << static_cast<uint64_t>(total / analyze_time) << " nodes/s (parse included)\n";
+    if (matched_string != matched_symbol) {
+        std::cerr << "dispatch mismatch: " << matched_string << " vs " << matched_symbol << "\n";
+        return 1;
+    }
+
+    ts_tree_delete(tree);
+    ts_parser_delete(parser);
+    return 0;
+}
@@ -0,0 +1,89 @@
+// collect_functions scaling benchmark: generated headers with N distinct
+// declarations (plus a repeat of every tenth one to exercise de-duplication).
+// With the old linear find_if the time per declaration grows with N; with the
+// hashed FunctionTable it stays flat.
+//
+// Usage: bench_functions [max_declarations]   (default 50000)
+#include "../patterns/functions.h"
+#include <chrono>
+#include <iomanip>
+
+static std::string generated_header(int declarations) {
+    std::ostringstream out;
+    out << "struct Message {\n";
+    for (int i = 0; i < declarations; i++) {
+        out << "    int field_" << i << "(int value);\n";
+        if (i % 10 == 0) out << "    int field_" << i << "(int value);\n";
+    }
+    out << "};\n";
+    return out.str();
+}
+
+// The pre-index de-duplication, kept for comparison.
+static size_t linear_dedupe(const std::vector<FunctionInfo>& input) {
+    std::vector<FunctionInfo> functions;
+    for (const FunctionInfo& candidate : input) {
+        auto it = std::find_if(functions.begin(), functions.end(), [&](const FunctionInfo& info) {
+            return info.name == candidate.name && info.declaration == candidate.declaration;
+        });
+        if (it == functions.end()) functions.push_back(candidate);
+    }
+    return functions.size();
+}
+
+static size_t hashed_dedupe(const std::vector<FunctionInfo>& input) {
+    std::vector<FunctionInfo> functions;
+    FunctionTable table(functions);
+    for (const FunctionInfo& candidate : input) table.add(candidate.name, candidate.declaration);
+    return functions.size();
+}
+
+template <typename Fn>
+static double seconds(Fn &&fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv) {
+    int max_declarations = argc > 1 ? std::atoi(argv[1]) : 50000;
+
+    TSParser *parser = ts_parser_new();
+    ts_parser_set_language(parser, tree_sitter_cpp());
+
+    std::cout << std::setw(10) << "decls" << std::setw(16) << "collect ns/decl"
+              << std::setw(16) << "linear ns/decl" << std::setw(16) << "hashed ns/decl" << "\n";
+    std::vector<int> sizes;
+    for (int n = 1000; n < max_declarations; n *= 2) sizes.push_back(n);
+    sizes.push_back(max_declarations);
+    for (int n : sizes) {
+        std::string code = generated_header(n);
+        TSTree *tree = ts_parser_parse_string(parser, nullptr, code.c_str(), code.size());
+
+        std::vector<FunctionInfo> functions;
+        double collect = seconds([&] { collect_functions(ts_tree_root_node(tree), code, functions); });
+
+        // Feed both de-duplication strategies the raw, duplicated stream.
+        std::vector<FunctionInfo> stream;
+        for (const FunctionInfo& info : functions) {
+            stream.push_back(info);
+            if (stream.size() % 10 == 1) stream.push_back(info);
+        }
+        size_t linear_count = 0, hashed_count = 0;
+        double linear = seconds([&] { linear_count = linear_dedupe(stream); });
+        double hashed = seconds([&] { hashed_count = hashed_dedupe(stream); });
+        if (linear_count != hashed_count || hashed_count != functions.size()) {
+            std::cerr << "de-duplication mismatch at " << n << " declarations\n";
+            return 1;
+        }
+
+        double per = 1e9 / n;
+        std::cout << std::setw(10) << n << std::setw(16) << static_cast<uint64_t>(collect * per)
+                  << std::setw(16) << static_cast<uint64_t>(linear * per)
+                  << std::setw(16) << static_cast<uint64_t>(hashed * per) << "\n";
+        ts_tree_delete(tree);
+    }
+
+    ts_parser_delete(parser);
+    return 0;
+}
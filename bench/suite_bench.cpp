@@ -0,0 +1,257 @@
+// Throughput suite: runs every analysis entry point over a set of synthetic
+// inputs shaped to stress different parts of the walkers, and reports MB/s and
+// nodes/s per input and operation. Run it before and after a change to catch
+// regressions; `cmake --build . --target bench` builds and runs it.
+//
+// Usage: bench_suite [scale] [repetitions]   (defaults 1 and 5)
+// Inputs (sizes are multiplied by scale):
+//   deep      nested blocks and parenthesized expressions
+//   wide      calls with very long argument lists
+//   flat      a huge file of small, independent functions
+//   templates a header of class templates with inline members
+#include "../patterns/analyzer.h"
+#include "../patterns/arena.h"
+#include "../patterns/constant_evaluator.h"
+#include "../patterns/functions.h"
+#include "../patterns/grammar.h"
+#include "../patterns/nodeprinter.h"
+#include "../patterns/returnv.h"
+#include "../patterns/source.h"
+#include "../patterns/visitor.h"
+#include <chrono>
+#include <iomanip>
+
+// Every corpus ends with `target`, so collect_return_values walks the whole
+// file before it finds the function it is looking for.
+static const char *target_function =
+    "int target(int n) {\n"
+    "    if (2 * 3 - 6) { return -1; }\n"
+    "    return (n + 4) * 2;\n"
+    "}\n";
+
+static std::string deep_nesting(int scale) {
+    std::ostringstream out;
+    for (int f = 0; f < 20 * scale; f++) {
+        int depth = 200;
+        out << "int deep" << f << "(int x) {\n";
+        for (int d = 0; d < depth; d++) out << "if (x > " << d << ") { x = x - 1;\n";
+        out << "int v = ";
+        for (int d = 0; d < depth; d++) out << "(" << (d % 7 + 1) << " + ";
+        out << "x";
+        for (int d = 0; d < depth; d++) out << ")";
+        out << ";\nreturn v;\n";
+        for (int d = 0; d < depth; d++) out << "}\n";
+        out << "return 0;\n}\n";
+    }
+    out << target_function;
+    return out.str();
+}
+
+static std::string wide_arguments(int scale) {
+    std::ostringstream out;
+    for (int f = 0; f < 20 * scale; f++) {
+        out << "void wide" << f << "(int *p) {\n";
+        for (int c = 0; c < 10; c++) {
+            out << "    consume(";
+            for (int a = 0; a < 1000; a++) out << (a ? ", " : "") << "p[" << a << "] + " << a % 10 << " * 2";
+            out << ");\n";
+        }
+        out << "}\n";
+    }
+    out << target_function;
+    return out.str();
+}
+
+static std::string flat_file(int scale) {
+    std::ostringstream out;
+    for (int f = 0; f < 20000 * scale; f++) {
+        out << "int flat" << f << "(int a, int b) {\n"
+            << "    int *p = (int *)malloc(sizeof(int) * (a + " << f % 13 << "));\n"
+            << "    p[0] = a * " << f % 5 + 1 << " + b;\n"
+            << "    int r = p[0] - 1;\n"
+            << "    free(p);\n"
+            << "    return r;\n"
+            << "}\n";
+    }
+    out << target_function;
+    return out.str();
+}
+
+static std::string template_header(int scale) {
+    std::ostringstream out;
+    for (int c = 0; c < 500 * scale; c++) {
+        out << "template <typename T, typename Alloc = std::allocator<T>, int N = " << c % 16 << ">\n"
+            << "class Box" << c << " : public Base<Box" << c << "<T, Alloc, N>> {\n"
+            << "public:\n"
+            << "    using value_type = typename std::remove_cv<T>::type;\n"
+            << "    int size(void);\n"
+            << "    int capacity(void);\n"
+            << "    template <typename U, typename = std::enable_if_t<std::is_convertible<U, T>::value>>\n"
+            << "    Box" << c << " &assign(const std::vector<U, Alloc> &values) {\n"
+            << "        data_ = std::make_unique<std::array<T, N * 2 + 1>>();\n"
+            << "        return *this;\n"
+            << "    }\n"
+            << "    ~Box" << c << "() { reset<T, N>(data_.get()); }\n"
+            << "private:\n"
+            << "    std::unique_ptr<std::array<T, N * 2 + 1>> data_;\n"
+            << "};\n";
+    }
+    out << target_function;
+    return out.str();
+}
+
+// Discards output but still makes the printer format every line.
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return c; }
+    std::streamsize xsputn(const char *, std::streamsize n) override { return n; }
+};
+
+static size_t count_nodes(TSNode root) {
+    size_t nodes = 0;
+    TreeWalker walker;
+    walker.walk(root, [&](TSNode, uint32_t) { nodes++; return Visit::Continue; });
+    return nodes;
+}
+
+// Outermost binary expressions: the inputs evaluate_expression is run on.
+static std::vector<TSNode> expressions(TSNode root, size_t &bytes, size_t &nodes) {
+    const CppGrammar &g = cpp_grammar();
+    std::vector<TSNode> found;
+    TreeWalker walker;
+    walker.walk(root, [&](TSNode node, uint32_t) {
+        if (ts_node_symbol(node) != g.binary_expression) return Visit::Continue;
+        found.push_back(node);
+        bytes += ts_node_end_byte(node) - ts_node_start_byte(node);
+        nodes += count_nodes(node);
+        return Visit::SkipChildren;
+    });
+    return found;
+}
+
+// Keeps evaluate_expression's results observable so the calls are not elided.
+static volatile long long checksum;
+
+template <typename Fn>
+static double seconds(Fn &&fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void report(const char *input, const char *operation, size_t bytes, size_t nodes, double time) {
+    std::cout << std::left << std::setw(11) << input << std::setw(24) << operation << std::right
+              << std::fixed << std::setprecision(1)
+              << std::setw(12) << bytes / time / 1e6
+              << std::setw(14) << static_cast<uint64_t>(nodes / time) << "\n";
+}
+
+int main(int argc, char **argv) {
+    int scale = argc > 1 ? std::max(1, std::atoi(argv[1])) : 1;
+    int repetitions = argc > 2 ? std::max(1, std::atoi(argv[2])) : 5;
+    // Needed for the arena rows; the per-block header it adds elsewhere is noise.
+    install_arena_allocator();
+
+    TSParser *parser = ts_parser_new();
+    ts_parser_set_language(parser, tree_sitter_cpp());
+
+    struct Input {
+        const char *name;
+        std::string code;
+    };
+    std::vector<Input> inputs = {
+        {"deep", deep_nesting(scale)},
+        {"wide", wide_arguments(scale)},
+        {"flat", flat_file(scale)},
+        {"templates", template_header(scale)},
+    };
+
+    std::cout << std::left << std::setw(11) << "input" << std::setw(24) << "operation" << std::right
+              << std::setw(12) << "MB/s" << std::setw(14) << "nodes/s" << "\n";
+    for (const Input &input : inputs) {
+        std::string_view code = input.code;
+        TSTree *tree = parse_source(parser, nullptr, code);
+        TSNode root = ts_tree_root_node(tree);
+        size_t bytes = code.size() * repetitions;
+        size_t nodes = count_nodes(root) * repetitions;
+
+        double time = 0;
+        for (int r = 0; r < repetitions; r++) {
+            time += seconds([&] { ts_tree_delete(parse_source(parser, nullptr, code)); });
+        }
+        report(input.name, "parse", bytes, nodes, time);
+
+        AnalysisOptions options;
+        options.functions = true;
+        options.return_function = "target";
+        time = 0;
+        for (int r = 0; r < repetitions; r++) {
+            AnalysisResult result;
+            time += seconds([&] { analyze_code(parser, code, result, options); });
+        }
+        report(input.name, "analyze_code (+parse)", bytes, nodes, time);
+
+        // As reviewer --arena runs it: a fresh parser per file, everything
+        // released at once.
+        Arena arena;
+        time = 0;
+        for (int r = 0; r < repetitions; r++) {
+            AnalysisResult result;
+            time += seconds([&] {
+                {
+                    ArenaScope scope(&arena);
+                    TSParser *file_parser = ts_parser_new();
+                    ts_parser_set_language(file_parser, tree_sitter_cpp());
+                    analyze_code(file_parser, code, result, options);
+                    ts_parser_delete(file_parser);
+                }
+                arena.release();
+            });
+        }
+        report(input.name, "analyze_code (arena)", bytes, nodes, time);
+
+        time = 0;
+        for (int r = 0; r < repetitions; r++) {
+            std::vector<FunctionInfo> functions;
+            time += seconds([&] { collect_functions(root, code, functions); });
+        }
+        report(input.name, "collect_functions", bytes, nodes, time);
+
+        time = 0;
+        for (int r = 0; r < repetitions; r++) {
+            time += seconds([&] {
+                if (collect_return_values(root, code, "target").empty()) std::cerr << "target not found\n";
+            });
+        }
+        report(input.name, "collect_return_values", bytes, nodes, time);
+
+        size_t expression_bytes = 0, expression_nodes = 0;
+        std::vector<TSNode> roots = expressions(root, expression_bytes, expression_nodes);
+        std::unordered_map<std::string, int> variables = {{"x", 3}, {"n", 5}};
+        long long sink = 0;
+        time = 0;
+        for (int r = 0; r < repetitions; r++) {
+            time += seconds([&] {
+                for (TSNode expression : roots) sink += evaluate_expression(expression, code, variables);
+            });
+        }
+        if (!roots.empty()) {
+            report(input.name, "evaluate_expression", expression_bytes * repetitions,
+                   expression_nodes * repetitions, time);
+        }
+
+        NullBuffer discard;
+        std::ostream null_out(&discard);
+        time = 0;
+        for (int r = 0; r < repetitions; r++) {
+            time += seconds([&] { print_node(root, code, 0, null_out); });
+        }
+        report(input.name, "print_node", bytes, nodes, time);
+
+        checksum = sink;
+        ts_tree_delete(tree);
+    }
+
+    ts_parser_delete(parser);
+    return 0;
+}
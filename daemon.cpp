@@ -0,0 +1,420 @@
+// Analysis server: keeps parsers and the trees of tracked files warm across
+// requests so an editor can ask for results on every save without paying for
+// process startup and parser construction each time.
+//
+// Protocol: newline-delimited JSON over a Unix domain socket. Each request is
+// one flat object on one line; each response is one line carrying the same
+// "id". Requests on one connection may be answered out of order when several
+// workers pick them up, so clients should match on "id".
+//
+//   {"id": 1, "method": "analyze", "path": "a.cpp", "code": "..."}
+//   {"id": 2, "method": "xref", "path": "a.cpp"}          (code read from disk)
+//   {"id": 3, "method": "returns", "code": "...", "function": "main"}
+//   {"id": 3, "method": "returns", "code": "..."}         (every function)
+//   {"id": 4, "method": "forget", "path": "a.cpp"}
+//   {"id": 5, "method": "ping"}
+//
+// analyze and xref requests that name a path are tracked: the file's tree and
+// per-declaration results are kept and the next request for the same path is
+// reparsed incrementally. Without a path the buffer is analyzed statelessly.
+//
+// Response: {"id": 1, "ok": true, "warnings": [...], "functions": [{"name":
+// ..., "declaration": ...}], "return_values": [...], "return_summaries":
+// [{"name": ..., "value": ..., "returns": true, "constant": ...}], "elapsed_us": N} or
+// {"id": 1, "ok": false, "error": "..."}.
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <cerrno>
+#include <cmath>
+#include <csignal>
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "patterns/analyzer.h"
+#include "patterns/callgraph.h"
+#include "patterns/instrument.h"
+#include "patterns/json.h"
+#include "patterns/parser_pool.h"
+#include "patterns/session.h"
+#include "patterns/source.h"
+#include "patterns/worker_pool.h"
+
+// Longest request line accepted before the connection is dropped.
+static const size_t max_request_bytes = 256u << 20;
+
+static volatile std::sig_atomic_t stop_requested = 0;
+
+static void request_stop(int) {
+    stop_requested = 1;
+}
+
+struct Connection {
+    explicit Connection(int fd) : fd(fd) {}
+    ~Connection() { close(fd); }
+
+    // Writes one whole response line; responses from different workers never interleave.
+    void send(const std::string &line) {
+        std::lock_guard<std::mutex> lock(write_mutex);
+        const char *data = line.data();
+        size_t left = line.size();
+        while (left > 0) {
+            ssize_t n = ::send(fd, data, left, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return; // client went away; nothing left to tell it
+            data += n;
+            left -= static_cast<size_t>(n);
+        }
+    }
+
+    int fd;
+    std::string pending; // bytes read but not yet terminated by a newline
+    std::mutex write_mutex;
+};
+
+struct Job {
+    std::shared_ptr<Connection> connection;
+    std::string line;
+};
+
+class JobQueue {
+public:
+    void push(Job job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            jobs_.push_back(std::move(job));
+        }
+        ready_.notify_one();
+    }
+
+    // Blocks until a job is available; returns false once closed and drained.
+    bool pop(Job &job) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        ready_.wait(lock, [&] { return closed_ || !jobs_.empty(); });
+        if (jobs_.empty()) return false;
+        job = std::move(jobs_.front());
+        jobs_.pop_front();
+        return true;
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+        }
+        ready_.notify_all();
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    std::deque<Job> jobs_;
+    bool closed_ = false;
+};
+
+// Everything kept warm between requests. Tracked files are spread over shards
+// by path so requests for different files rarely wait on each other, while
+// requests for the same file are serialized on its shard.
+class Server {
+public:
+    explicit Server(unsigned workers) : pool_(workers), shards_(workers * 4) {
+        AnalysisOptions analyze;
+        AnalysisOptions xref;
+        xref.memory = false;
+        xref.functions = true;
+        for (Shard &shard : shards_) {
+            shard.analyze = std::make_unique<AnalysisSession>(analyze, &pool_);
+            shard.xref = std::make_unique<AnalysisSession>(xref, &pool_);
+        }
+    }
+
+    std::string handle(const std::string &line);
+
+private:
+    struct Shard {
+        std::mutex mutex;
+        std::unique_ptr<AnalysisSession> analyze;
+        std::unique_ptr<AnalysisSession> xref;
+    };
+
+    Shard &shard_for(const std::string &path) {
+        return shards_[std::hash<std::string>()(path) % shards_.size()];
+    }
+
+    ParserPool pool_;
+    std::vector<Shard> shards_;
+};
+
+static void write_string_array(std::ostream &out, const std::vector<std::string> &values) {
+    out << '[';
+    for (size_t i = 0; i < values.size(); i++) {
+        if (i) out << ", ";
+        write_json_string(out, values[i]);
+    }
+    out << ']';
+}
+
+static void write_id(std::ostream &out, const JsonObject &request) {
+    out << "{\"id\": ";
+    auto id = request.find("id");
+    if (id == request.end() || id->second.type == JsonValue::Null) {
+        out << "null";
+    } else if (id->second.type == JsonValue::String) {
+        write_json_string(out, id->second.string);
+    } else if (id->second.type == JsonValue::Number) {
+        double number = id->second.number;
+        if (number == std::floor(number) && std::fabs(number) < 9e15) {
+            out << static_cast<long long>(number);
+        } else {
+            out.precision(17);
+            out << number;
+        }
+    } else {
+        out << (id->second.boolean ? "true" : "false");
+    }
+}
+
+static std::string field(const JsonObject &request, const char *name) {
+    auto it = request.find(name);
+    if (it == request.end() || it->second.type == JsonValue::Null) return std::string();
+    if (it->second.type != JsonValue::String) {
+        throw std::runtime_error(std::string("Error: \"") + name + "\" must be a string");
+    }
+    return it->second.string;
+}
+
+std::string Server::handle(const std::string &line) {
+    uint64_t start = monotonic_nanos();
+    JsonObject request;
+    std::ostringstream out;
+    try {
+        request = parse_json_object(line);
+        write_id(out, request);
+        std::string method = field(request, "method");
+        std::string path = field(request, "path");
+        if (method == "ping") {
+            out << ", \"ok\": true}\n";
+            return out.str();
+        }
+        if (method == "forget") {
+            if (path.empty()) throw std::runtime_error("Error: forget needs a \"path\"");
+            Shard &shard = shard_for(path);
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.analyze->forget(path);
+            shard.xref->forget(path);
+            out << ", \"ok\": true}\n";
+            return out.str();
+        }
+        if (method != "analyze" && method != "xref" && method != "returns") {
+            throw std::runtime_error("Error: unknown method \"" + method + "\"");
+        }
+
+        // The buffer comes with the request, or from disk when only a path is given.
+        std::string code;
+        bool has_code = request.count("code") != 0;
+        SourceFile source;
+        if (has_code) {
+            code = field(request, "code");
+        } else if (!path.empty()) {
+            source = SourceFile(path);
+        } else {
+            throw std::runtime_error("Error: " + method + " needs \"code\" or \"path\"");
+        }
+        std::string_view text = has_code ? std::string_view(code) : source.text();
+
+        AnalysisResult result;
+        if (method == "returns") {
+            AnalysisOptions options;
+            options.memory = false;
+            options.return_function = field(request, "function");
+            options.return_summaries = options.return_function.empty();
+            analyze_code(pool_.acquire(), text, result, options);
+        } else if (!path.empty()) {
+            Shard &shard = shard_for(path);
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            AnalysisSession &session = method == "analyze" ? *shard.analyze : *shard.xref;
+            result = session.update(path, text);
+        } else {
+            AnalysisOptions options;
+            if (method == "xref") {
+                options.memory = false;
+                options.functions = true;
+            }
+            analyze_code(pool_.acquire(), text, result, options);
+        }
+
+        out << ", \"ok\": true, \"warnings\": ";
+        write_string_array(out, result.warnings);
+        out << ", \"functions\": [";
+        for (size_t i = 0; i < result.functions.size(); i++) {
+            out << (i ? ", " : "") << "{\"name\": ";
+            write_json_string(out, result.functions[i].name);
+            out << ", \"declaration\": ";
+            write_json_string(out, result.functions[i].declaration);
+            out << '}';
+        }
+        out << "], \"return_values\": ";
+        write_string_array(out, result.return_values);
+        out << ", \"return_summaries\": [";
+        for (size_t i = 0; i < result.return_summaries.size(); i++) {
+            const ReturnSummary &summary = result.return_summaries[i];
+            out << (i ? ", " : "") << "{\"name\": ";
+            write_json_string(out, summary.name);
+            out << ", \"value\": ";
+            write_json_string(out, summary.value);
+            out << ", \"returns\": " << (summary.returns ? "true" : "false") << ", \"constant\": ";
+            write_json_string(out, constant_text(returned_constant(summary.constant, summary.type)));
+            out << '}';
+        }
+        out << ']';
+        out << ", \"elapsed_us\": " << (monotonic_nanos() - start) / 1000 << "}\n";
+        return out.str();
+    } catch (const std::exception &e) {
+        std::ostringstream error;
+        write_id(error, request);
+        error << ", \"ok\": false, \"error\": ";
+        write_json_string(error, e.what());
+        error << "}\n";
+        return error.str();
+    }
+}
+
+// Anyone who can connect can have the daemon read any file it can, so the
+// socket is created readable and writable by its owner only. A stale socket
+// from an earlier run is replaced; anything else at `path` is left alone.
+static int listen_on(const std::string &path) {
+    sockaddr_un address{};
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Error: socket path too long: " + path);
+    }
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    struct stat existing;
+    if (lstat(path.c_str(), &existing) == 0) {
+        if (!S_ISSOCK(existing.st_mode)) throw std::runtime_error("Error: " + path + " exists and is not a socket");
+        unlink(path.c_str());
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) throw std::runtime_error("Error: Cannot create socket: " + std::string(std::strerror(errno)));
+    // bind creates the file under this umask, so there is no moment at which
+    // others may connect; the chmod then sets the mode outright.
+    mode_t mask = umask(0177);
+    int bound = bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+    umask(mask);
+    if (bound < 0 || chmod(path.c_str(), 0600) < 0 || listen(fd, 64) < 0) {
+        std::string reason = std::strerror(errno);
+        close(fd);
+        throw std::runtime_error("Error: Cannot listen on " + path + ": " + reason);
+    }
+    return fd;
+}
+
+// Reads what is available on `connection` and queues every complete line.
+// Returns false when the connection should be dropped.
+static bool read_requests(const std::shared_ptr<Connection> &connection, JobQueue &queue) {
+    char buffer[64 * 1024];
+    ssize_t n = read(connection->fd, buffer, sizeof(buffer));
+    if (n < 0 && errno == EINTR) return true;
+    if (n <= 0) return false;
+    std::string &pending = connection->pending;
+    size_t scanned = pending.size();
+    pending.append(buffer, static_cast<size_t>(n));
+    size_t line_start = 0;
+    for (size_t newline; (newline = pending.find('\n', scanned)) != std::string::npos; scanned = line_start) {
+        if (newline > line_start) queue.push({connection, pending.substr(line_start, newline - line_start)});
+        line_start = newline + 1;
+    }
+    pending.erase(0, line_start);
+    if (pending.size() > max_request_bytes) {
+        connection->send("{\"id\": null, \"ok\": false, \"error\": \"Error: request too long\"}\n");
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    std::string socket_path;
+    unsigned jobs = 0;
+    bool bad_arguments = false;
+    for (int i = 1; i < argc && !bad_arguments; i++) {
+        std::string arg = argv[i];
+        if (arg == "--socket" && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else if ((arg == "-j" || arg == "--jobs") && i + 1 < argc) {
+            bad_arguments = !parse_worker_count(argv[++i], jobs);
+        } else if (arg.rfind("-j", 0) == 0 && arg.size() > 2) {
+            bad_arguments = !parse_worker_count(arg.substr(2), jobs);
+        } else {
+            bad_arguments = true;
+        }
+    }
+    if (socket_path.empty() || bad_arguments) {
+        std::cerr << "Usage: " << argv[0] << " --socket path [-j jobs]\n";
+        return 1;
+    }
+    if (jobs == 0) jobs = default_worker_count();
+
+    int listener;
+    try {
+        listener = listen_on(socket_path);
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    std::signal(SIGPIPE, SIG_IGN);
+    std::signal(SIGINT, request_stop);
+    std::signal(SIGTERM, request_stop);
+
+    Server server(jobs);
+    JobQueue queue;
+    std::vector<std::thread> workers;
+    for (unsigned w = 0; w < jobs; w++) {
+        workers.emplace_back([&] {
+            Job job;
+            while (queue.pop(job)) {
+                job.connection->send(server.handle(job.line));
+                job.connection.reset();
+            }
+        });
+    }
+
+    // One thread multiplexes accepting and reading; workers only parse and analyze.
+    // A connection closes once the client hung up and its queued requests are done.
+    std::vector<std::shared_ptr<Connection>> connections;
+    while (!stop_requested) {
+        std::vector<pollfd> fds;
+        fds.push_back({listener, POLLIN, 0});
+        for (const auto &connection : connections) fds.push_back({connection->fd, POLLIN, 0});
+        int ready = poll(fds.data(), fds.size(), 250);
+        if (ready < 0 && errno != EINTR) break;
+        if (ready <= 0) continue;
+
+        std::vector<std::shared_ptr<Connection>> alive;
+        for (size_t i = 1; i < fds.size(); i++) {
+            bool keep = true;
+            if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) keep = read_requests(connections[i - 1], queue);
+            if (keep) alive.push_back(connections[i - 1]);
+        }
+        connections = std::move(alive);
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(listener, nullptr, nullptr);
+            if (fd >= 0) connections.push_back(std::make_shared<Connection>(fd));
+        }
+    }
+
+    close(listener);
+    unlink(socket_path.c_str());
+    connections.clear();
+    queue.close();
+    for (std::thread &worker : workers) worker.join();
+    return 0;
+}
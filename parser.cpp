@@ -1,201 +1,288 @@
 #include <iostream>
-#include <fstream>
 #include <vector>
-#include <set>
-#include <unordered_map>
-#include <unordered_set>
 #include <string>
 #include <algorithm>
 #include <stdexcept>
+#include <fstream>
 #include <tree_sitter/api.h>
+#include "patterns/analyzer.h"
+#include "patterns/arena.h"
+#include "patterns/budget.h"
+#include "patterns/callgraph.h"
+#include "patterns/cache.h"
+#include "patterns/instrument.h"
+#include "patterns/rules.h"
+#include "patterns/session.h"
+#include "patterns/source.h"
+#include "patterns/worker_pool.h"
 
-extern "C" TSLanguage *tree_sitter_cpp();
-
-struct AnalysisResult {
-    std::vector<std::string> warnings;
-    void add_warning(const std::string &msg) {
-        warnings.push_back(msg);
+static void print_report(const std::string &prefix, const AnalysisResult &result, const AnalysisOptions &options) {
+    if (!result.incomplete.empty()) {
+        std::cout << prefix << "Incomplete: " << result.incomplete << "\n";
     }
-};
+    for (const std::string &warning : result.warnings) {
+        std::cout << prefix << "Warning: " << warning << "\n";
+    }
+    for (const std::string &return_value : result.return_values) {
+        std::cout << prefix << "Return value: " << return_value << "\n";
+    }
+    if (options.functions) {
+        if (!prefix.empty()) std::cout << prefix << "\n";
+        print_function_table(result.functions);
+    }
+    if (options.return_summaries) {
+        if (!prefix.empty()) std::cout << prefix << "\n";
+        print_return_summaries(result.return_summaries);
+    }
+}
 
-std::string read_file(const std::string &filename) {
-    std::ifstream file(filename, std::ios::binary | std::ios::ate);
-    if (!file) {
-        throw std::runtime_error("Error: Cannot open file " + filename);
-    }
-    std::streamsize size = file.tellg();
-    file.seekg(0, std::ios::beg);
-    std::string buffer(size, '\0');
-    if (!file.read(buffer.data(), size)) {
-        throw std::runtime_error("Error: Cannot read file " + filename);
-    }
-    return buffer;
+// Session mode: reads one path per line from stdin and reanalyzes that file,
+// keeping every file's tree and per-declaration results between requests so
+// a small change costs an incremental reparse. Each report is terminated by
+// an `== <path>` line.
+static int run_session(const AnalysisOptions &options) {
+    AnalysisSession session(options);
+    std::string path;
+    while (std::getline(std::cin, path)) {
+        if (path.empty()) continue;
+        try {
+            SourceFile source(path);
+            print_report(path + ": ", session.update(path, source.text()), options);
+        } catch (const std::exception &e) {
+            std::cerr << e.what() << "\n";
+        }
+        std::cout << "== " << path << std::endl;
+    }
+    return 0;
 }
 
-void analyze_code(const std::string &code, AnalysisResult &result) {
+// Runs analyze_code with the parser, the tree and the analysis containers
+// all allocated from `arena`, then drops everything at once. The parser is
+// made inside the scope because its buffers would otherwise end up pointing
+// into released memory; the result's strings stay on the heap.
+static void analyze_in_arena(Arena &arena, std::string_view code, AnalysisResult &result,
+                             const AnalysisOptions &options) {
+    struct Release {
+        Arena &arena;
+        ~Release() { arena.release(); }
+    } release{arena};
+    ArenaScope scope(&arena);
     TSParser *parser = ts_parser_new();
     ts_parser_set_language(parser, tree_sitter_cpp());
-    TSTree *tree = ts_parser_parse_string(parser, nullptr, code.c_str(), code.size());
-    TSNode root_node = ts_tree_root_node(tree);
+    analyze_code(parser, code, result, options);
+    ts_parser_delete(parser);
+}
 
-    std::unordered_map<std::string, int> allocation_count;
-    std::unordered_map<std::string, int> deallocation_count;
-    std::unordered_map<std::string, std::string> allocated_pointers;
-    std::unordered_set<std::string> freed_pointers;
-    std::unordered_map<std::string, int> recursion_count;
-    std::vector<TSNode> stack = {root_node};
-    bool uses_dp_table = false;
+struct FileReport {
+    std::string error;
+    AnalysisResult result;
+    Metrics metrics;
+};
 
-    std::set<std::string> alloc_functions = {"malloc", "calloc", "realloc", "VirtualAlloc", "mmap", "new"};
-    std::set<std::string> dealloc_functions = {"free", "VirtualFree", "munmap", "delete"};
+// Writes the --stats summary; CSV when the path ends in .csv, JSON otherwise.
+static void write_stats(const std::string &path, const std::vector<std::string> &files,
+                        const std::vector<FileReport> &reports, uint64_t wall_nanos) {
+    std::vector<Metrics> metrics;
+    for (const FileReport &report : reports) metrics.push_back(report.metrics);
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Error: Cannot write stats to " << path << "\n";
+        return;
+    }
+    bool csv = path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0;
+    if (csv) {
+        write_metrics_csv(out, files, metrics, wall_nanos);
+    } else {
+        write_metrics_json(out, files, metrics, wall_nanos);
+    }
+}
 
+static void print_usage(const char *program) {
+    std::cerr << "Usage: " << program << " [-j jobs] [--cache dir] [--stats out.json|out.csv] [--xref] [--returns function] [--all-returns] [--call-graph] [--rules rules.scm] [--no-memory] [--arena] [--time-budget ms] [--node-budget nodes] <file|directory>...\n"
+              << "       " << program << " --session [--xref] [--returns function] [--all-returns] [--rules rules.scm] [--no-memory] < paths\n";
+}
 
-    while (!stack.empty()) {
-        TSNode node = stack.back();
-        stack.pop_back();
-        std::string type = ts_node_type(node);
-        
-        if (type == "init_declarator") {
-            std::string var_name;
-            for (uint32_t i = 0; i < ts_node_child_count(node); i++) {
-                TSNode child = ts_node_child(node, i);
-                std::string child_type = ts_node_type(child);
-                if (child_type == "identifier") {
-                    var_name = ts_node_string(child);
-                } else if (child_type == "call_expression") {
-                    TSNode func_node = ts_node_child(child, 0);
-                    std::string func_name = ts_node_string(func_node);
-                    if (alloc_functions.count(func_name)) {
-                        allocation_count[var_name]++;
-                        allocated_pointers[var_name] = func_name;
-                    }
-                } else if (child_type == "new_expression") {
-                    allocation_count[var_name]++;
-                    allocated_pointers[var_name] = "new";
-                }
-            }
-        } else if (type == "delete_expression") {
-            TSNode deleted_var_node;
-            for (uint32_t i = 0; i < ts_node_child_count(node); ++i) {
-                TSNode child = ts_node_child(node, i);
-                std::string child_type = ts_node_type(child);
-                if (child_type == "identifier" || child_type == "field_expression" || child_type == "subscript_expression") {
-                    deleted_var_node = child;
-                    break;
-                }
-            }
-            if (!ts_node_is_null(deleted_var_node)) {
-                std::string var_name = ts_node_string(deleted_var_node);
-                deallocation_count[var_name]++;
-                if (allocated_pointers.find(var_name) != allocated_pointers.end()) {
-                    if (freed_pointers.find(var_name) != freed_pointers.end()) {
-                        result.add_warning("Use-after-free detected: Attempt to delete already freed pointer " + var_name);
-                    }
-                    freed_pointers.insert(var_name);
-                    allocated_pointers.erase(var_name);
-                } else {
-                    result.add_warning("Deleting a pointer that was never allocated: " + var_name);
-                }
-            }
-        } else if (type == "call_expression") {
-            TSNode func_node = ts_node_child(node, 0);
-            std::string func_name = ts_node_string(func_node);
-            // Handle deallocation functions like free()
-            if (dealloc_functions.count(func_name)) {
-                TSNode args_node;
-                for (uint32_t i = 0; i < ts_node_child_count(node); i++) {
-                    TSNode child = ts_node_child(node, i);
-                    if (ts_node_type(child) == "argument_list") {
-                        args_node = child;
-                        break;
-                    }
-                }
-                if (!ts_node_is_null(args_node)) {
-                    TSNode first_arg = ts_node_child(args_node, 0);
-                    if (!ts_node_is_null(first_arg)) {
-                        std::string var_name = ts_node_string(first_arg);
-                        deallocation_count[var_name]++;
-                        if (allocated_pointers.find(var_name) != allocated_pointers.end()) {
-                            if (freed_pointers.find(var_name) != freed_pointers.end()) {
-                                result.add_warning("Use-after-free detected: " + var_name);
-                            }
-                            freed_pointers.insert(var_name);
-                            allocated_pointers.erase(var_name);
-                        } else {
-                            result.add_warning("Deallocating unallocated pointer: " + var_name);
-                        }
-                    }
-                }
-            }
-            // Removed greedy check for sort functions to focus on memory leaks.
-            if (func_name.find("sort") != std::string::npos) {
-                result.add_warning("Possible greedy approach detected. Consider DP if optimization is needed.");
-            }
-        } else if (type == "assignment_expression") {
-            TSNode lhs = ts_node_child(node, 0);
-            TSNode rhs = ts_node_child(node, 1);
-            std::string rhs_type = ts_node_type(rhs);
-            if (rhs_type == "call_expression") {
-                TSNode func_node = ts_node_child(rhs, 0);
-                std::string func_name = ts_node_string(func_node);
-                if (alloc_functions.count(func_name)) {
-                    if (ts_node_type(lhs) == "identifier") {
-                        std::string var_name = ts_node_string(lhs);
-                        allocation_count[var_name]++;
-                        allocated_pointers[var_name] = func_name;
-                    }
-                }
-            } else if (rhs_type == "new_expression") {
-                if (ts_node_type(lhs) == "identifier") {
-                    std::string var_name = ts_node_string(lhs);
-        }
+int main(int argc, char *argv[]) {
+    unsigned jobs = 0;
+    bool session = false;
+    bool arena = false;
+    bool call_graph = false;
+    Budget budget;
+    std::string cache_directory;
+    std::string stats_path;
+    std::string rules_path;
+    AnalysisOptions options;
+    std::vector<std::string> operands;
+    bool bad_arguments = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--xref") {
+            options.functions = true;
+        } else if (arg == "--returns" && i + 1 < argc) {
+            options.return_function = argv[++i];
+        } else if (arg == "--all-returns") {
+            options.return_summaries = true;
+        } else if (arg == "--call-graph") {
+            call_graph = true;
+        } else if (arg == "--cache" && i + 1 < argc) {
+            cache_directory = argv[++i];
+        } else if (arg == "--stats" && i + 1 < argc) {
+            stats_path = argv[++i];
+        } else if (arg == "--rules" && i + 1 < argc) {
+            rules_path = argv[++i];
+        } else if (arg == "--session") {
+            session = true;
+        } else if (arg == "--time-budget" && i + 1 < argc) {
+            // Milliseconds on the command line, microseconds in the budget.
+            uint64_t millis;
+            if (parse_unsigned(argv[++i], UINT64_MAX / 1000, millis)) {
+                budget.time_micros = millis * 1000;
+            } else {
+                bad_arguments = true;
             }
-        } else if (type == "function_declarator") {
-            std::string func_name = ts_node_string(node);
-            recursion_count[func_name]++;
-        } else if (type == "subscript_expression") {
-            uses_dp_table = true;
-        }
-        
-        for (uint32_t i = 0; i < ts_node_child_count(node); i++) {
-            stack.push_back(ts_node_child(node, i));
+        } else if (arg == "--node-budget" && i + 1 < argc) {
+            bad_arguments |= !parse_unsigned(argv[++i], UINT64_MAX, budget.node_limit);
+        } else if (arg == "--arena") {
+            arena = true;
+        } else if (arg == "--no-memory") {
+            options.memory = false;
+        } else if ((arg == "-j" || arg == "--jobs") && i + 1 < argc) {
+            bad_arguments |= !parse_worker_count(argv[++i], jobs);
+        } else if (arg.rfind("-j", 0) == 0 && arg.size() > 2) {
+            bad_arguments |= !parse_worker_count(arg.substr(2), jobs);
+        } else {
+            operands.push_back(arg);
         }
     }
-    
-    for (const auto &[var_name, count] : allocation_count) {
-        if (deallocation_count[var_name] < count) {
-            result.add_warning("Potential memory leak: Variable `" + var_name + "` allocated " + std::to_string(count) + " times without corresponding deallocation.");
-        }
+    // A session analyzes paths read from stdin with no caching, statistics,
+    // arena, call graph, worker pool or budget; asking for any of those is
+    // an error rather than silently ignored.
+    bad_arguments |= session && (arena || call_graph || !cache_directory.empty() || !stats_path.empty() ||
+                                 budget.time_micros || budget.node_limit || jobs || !operands.empty());
+    if (bad_arguments) {
+        print_usage(argv[0]);
+        return 1;
     }
-    
-    for (const auto &[func_name, count] : recursion_count) {
-        if (count > 1 && uses_dp_table) {
-            result.add_warning("Dynamic Programming detected: Recursive function `" + func_name + "` combined with table usage.");
+    // The hooks must be in place before tree-sitter allocates anything,
+    // including the rule check below.
+    if (arena && !session) install_arena_allocator();
+    if (!rules_path.empty()) {
+        // Loaded and checked once here so a bad rule file fails before any analysis.
+        try {
+            options.rules = std::string(SourceFile(rules_path).text());
+            AnalysisResult scratch;
+            RuleChecker check(options.rules, scratch);
+        } catch (const std::exception &e) {
+            std::cerr << e.what() << "\n";
+            return 1;
         }
     }
-    
-    ts_tree_delete(tree);
-    ts_parser_delete(parser);
-}
-
-int main(int argc, char *argv[]) {
-    if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <filename>\n";
+    if (session) {
+        return run_session(options);
+    }
+    // The per-file tables are only printed when asked for; the call graph
+    // needs the summaries either way.
+    AnalysisOptions printed = options;
+    options.return_summaries |= call_graph;
+    if (operands.empty()) {
+        print_usage(argv[0]);
         return 1;
     }
 
+    std::vector<std::string> files;
     try {
-        std::string code = read_file(argv[1]);
-        AnalysisResult result;
-        analyze_code(code, result);
-
-        for (const std::string &warning : result.warnings) {
-            std::cout << "Warning: " << warning << "\n";
-        }
+        files = collect_sources(operands);
     } catch (const std::exception &e) {
         std::cerr << e.what() << "\n";
         return 1;
     }
+    if (jobs == 0) jobs = default_worker_count();
+    bool instrument = !stats_path.empty();
+    bool budgeted = budget.time_micros || budget.node_limit;
+    if (instrument && !arena) count_tree_sitter_allocations();
+    uint64_t run_start = monotonic_nanos();
 
-    return 0;
+    // One parser per worker, created up front and reused for every file the
+    // worker picks up; with --arena, one arena per worker instead, released
+    // after every file. Reports are stored by file index so the output order
+    // is the same no matter how the files were scheduled.
+    size_t workers = std::min<size_t>(jobs, std::max<size_t>(files.size(), 1));
+    std::vector<TSParser *> parsers;
+    std::vector<std::unique_ptr<Arena>> arenas;
+    for (size_t w = 0; w < workers; w++) {
+        if (arena) {
+            arenas.push_back(std::make_unique<Arena>());
+            continue;
+        }
+        parsers.push_back(ts_parser_new());
+        ts_parser_set_language(parsers.back(), tree_sitter_cpp());
+    }
+    std::unique_ptr<ResultCache> cache;
+    if (!cache_directory.empty()) cache = std::make_unique<ResultCache>(cache_directory);
+    std::vector<FileReport> reports(files.size());
+    parallel_for(files.size(), static_cast<unsigned>(workers), [&](size_t index, unsigned worker) {
+        FileReport &report = reports[index];
+        MetricsScope scope(instrument ? &report.metrics : nullptr);
+        // Started before the read so a slow file system counts against it.
+        BudgetScope limit(budgeted ? &budget : nullptr);
+        try {
+            // Mapping is lazy, so page-in cost shows up under parse; read
+            // covers opening the file and, with --cache, hashing and lookup.
+            SourceFile source;
+            std::string key;
+            {
+                PhaseTimer timer(phase_read);
+                source = SourceFile(files[index]);
+                if (cache) {
+                    key = cache->key(source.text(), options);
+                    report.metrics.cache_hit = cache->load(key, report.result);
+                }
+            }
+            if (report.metrics.cache_hit) return;
+            if (arena) {
+                analyze_in_arena(*arenas[worker], source.text(), report.result, options);
+            } else {
+                analyze_code(parsers[worker], source.text(), report.result, options);
+            }
+            // A partial result would hide the full one on the next run.
+            if (cache && report.result.incomplete.empty()) cache->store(key, report.result);
+        } catch (const std::exception &e) {
+            report.error = e.what();
+        }
+    });
+    for (TSParser *parser : parsers) {
+        ts_parser_delete(parser);
+    }
+
+    bool failed = false;
+    bool prefix = files.size() > 1;
+    for (size_t i = 0; i < files.size(); i++) {
+        if (!reports[i].error.empty()) {
+            std::cerr << reports[i].error << "\n";
+            failed = true;
+            continue;
+        }
+        MetricsScope scope(instrument ? &reports[i].metrics : nullptr);
+        PhaseTimer timer(phase_report);
+        print_report(prefix ? files[i] + ": " : std::string(), reports[i].result, printed);
+    }
+    if (call_graph) {
+        CallGraph graph;
+        for (size_t i = 0; i < files.size(); i++) {
+            if (reports[i].error.empty()) graph.set_file(files[i], std::move(reports[i].result.return_summaries));
+        }
+        graph.solve(jobs);
+        print_resolved_returns(graph.results());
+    }
+    std::cout.flush();
+
+    if (instrument) {
+        write_stats(stats_path, files, reports, monotonic_nanos() - run_start);
+    }
+
+    if (cache) {
+        std::cerr << "cache: " << cache->hits() << " hits, " << cache->misses() << " misses\n";
+    }
+
+    return failed ? 1 : 0;
 }
@@ -0,0 +1,466 @@
+#include "analyzer.h"
+#include "budget.h"
+#include "dataflow.h"
+#include "returnv.h"
+#include "rules.h"
+#include "source.h"
+#include "instrument.h"
+#include "visitor.h"
+#include <string_view>
+
+struct MemoryEvent {
+    PointerEvent::Kind kind;
+    uint32_t byte;
+    uint32_t variable; // interned text of the pointer expression
+};
+
+struct LocalDeclaration {
+    uint32_t byte;
+    uint32_t variable;
+};
+
+struct LocatedWarning {
+    uint32_t byte;
+    std::string text;
+};
+
+// What the query matches collect; everything is judged in finish(), once the
+// function bodies the events belong to are known.
+// Names are interned, so the tables below are arrays indexed by id. Every
+// container takes its memory from analysis_memory(), the file's arena when
+// one is active.
+struct MemoryState {
+    std::string_view code;
+    StringInterner &strings;
+    std::pmr::memory_resource *memory;
+    std::pmr::vector<MemoryEvent> events;
+    std::pmr::vector<TSNode> bodies;
+    std::pmr::vector<LocalDeclaration> locals;
+    std::pmr::vector<uint32_t> greedy_calls;
+    std::pmr::vector<LocatedWarning> leaks;
+    std::pmr::vector<int> recursion_count;       // by function name id
+    std::pmr::vector<uint32_t> declared_functions; // name ids, first-seen order
+    bool uses_dp_table = false;
+
+    MemoryState(std::string_view code, StringInterner &strings)
+        : code(code), strings(strings), memory(analysis_memory()), events(memory), bodies(memory), locals(memory),
+          greedy_calls(memory), leaks(memory), recursion_count(memory), declared_functions(memory) {}
+
+    uint32_t intern(TSNode node) { return strings.intern(node_text(node, code)); }
+};
+
+namespace {
+
+// The function lists are tiny, so a linear scan over string_views beats a
+// std::set<std::string> lookup and never allocates a key.
+constexpr std::string_view alloc_functions[] = {"malloc", "calloc", "realloc", "VirtualAlloc", "mmap", "new"};
+constexpr std::string_view dealloc_functions[] = {"free", "VirtualFree", "munmap", "delete"};
+
+template <size_t N>
+bool contains(const std::string_view (&list)[N], std::string_view name) {
+    return std::find(std::begin(list), std::end(list), name) != std::end(list);
+}
+
+// Strips `*` / `&` declarators so `int *p = ...` yields `p`.
+TSNode declarator_name(TSNode declarator) {
+    const CppGrammar &g = cpp_grammar();
+    while (!ts_node_is_null(declarator)) {
+        TSSymbol symbol = ts_node_symbol(declarator);
+        if (symbol != g.pointer_declarator && symbol != g.reference_declarator) break;
+        declarator = ts_node_child_by_field_id(declarator, g.field_declarator);
+    }
+    return declarator;
+}
+
+// Capture ids of memory_query(), resolved once.
+struct MemoryCaptures {
+    uint32_t declarator, value, function, target, call, body;
+};
+const MemoryCaptures &memory_captures();
+
+void add_event(MemoryState &state, PointerEvent::Kind kind, uint32_t byte, TSNode variable) {
+    state.events.push_back({kind, byte, state.intern(variable)});
+}
+
+bool is_allocation(MemoryState &state, TSNode value) {
+    const CppGrammar &g = cpp_grammar();
+    TSSymbol symbol = ts_node_symbol(value);
+    if (symbol == g.new_expression) return true;
+    if (symbol != g.call_expression) return false;
+    TSNode function = ts_node_child_by_field_id(value, g.field_function);
+    return contains(alloc_functions, node_text(function, state.code));
+}
+
+// Copying a pointer hands the allocation to someone this analysis does not
+// follow, so the copied variable stops being checked for leaks.
+void escape_if_identifier(MemoryState &state, TSNode value) {
+    if (ts_node_symbol(value) == cpp_grammar().identifier) {
+        add_event(state, PointerEvent::Escape, ts_node_start_byte(value), value);
+    }
+}
+
+// `T *p = alloc(...)` / `T *p = new T` / `T *p = q`
+void on_initialization(MemoryState &state, const QueryMatch &match) {
+    const MemoryCaptures &c = memory_captures();
+    TSNode name = declarator_name(match.capture(c.declarator));
+    if (ts_node_is_null(name) || ts_node_symbol(name) != cpp_grammar().identifier) return;
+    TSNode value = match.capture(c.value);
+    if (is_allocation(state, value)) {
+        add_event(state, PointerEvent::Allocate, ts_node_start_byte(name), name);
+    } else {
+        escape_if_identifier(state, value);
+    }
+}
+
+// `p = alloc(...)` / `p = new T` / `p = anything else`
+void on_assignment(MemoryState &state, const QueryMatch &match) {
+    const MemoryCaptures &c = memory_captures();
+    TSNode name = match.capture(c.declarator);
+    TSNode value = match.capture(c.value);
+    bool allocates = is_allocation(state, value);
+    if (!allocates) escape_if_identifier(state, value);
+    add_event(state, allocates ? PointerEvent::Allocate : PointerEvent::Rebind, ts_node_start_byte(name),
+              name);
+}
+
+void on_delete_expression(MemoryState &state, const QueryMatch &match) {
+    TSNode target = match.capture(memory_captures().target);
+    add_event(state, PointerEvent::Delete, ts_node_start_byte(target), target);
+}
+
+void on_call_expression(MemoryState &state, const QueryMatch &match) {
+    const MemoryCaptures &c = memory_captures();
+    TSNode call = match.capture(c.call);
+    std::string_view func_name = node_text(match.capture(c.function), state.code);
+    // Handle deallocation functions like free()
+    if (contains(dealloc_functions, func_name)) {
+        TSNode args_node = ts_node_child_by_field_id(call, cpp_grammar().field_arguments);
+        TSNode first_arg = ts_node_is_null(args_node) ? args_node : ts_node_named_child(args_node, 0);
+        if (!ts_node_is_null(first_arg)) {
+            add_event(state, PointerEvent::Free, ts_node_start_byte(call), first_arg);
+        }
+    }
+    if (func_name.find("sort") != std::string_view::npos) {
+        state.greedy_calls.push_back(ts_node_start_byte(call));
+    }
+}
+
+void on_return(MemoryState &state, const QueryMatch &match) {
+    escape_if_identifier(state, match.capture(memory_captures().target));
+}
+
+void on_declaration(MemoryState &state, const QueryMatch &match) {
+    const CppGrammar &g = cpp_grammar();
+    TSNode declarator = match.capture(memory_captures().declarator);
+    if (ts_node_symbol(declarator) == g.init_declarator) {
+        declarator = ts_node_child_by_field_id(declarator, g.field_declarator);
+    }
+    TSNode name = declarator_name(declarator);
+    if (ts_node_is_null(name) || ts_node_symbol(name) != g.identifier) return;
+    state.locals.push_back({ts_node_start_byte(name), state.intern(name)});
+}
+
+void on_function_body(MemoryState &state, const QueryMatch &match) {
+    state.bodies.push_back(match.capture(memory_captures().body));
+}
+
+void on_function_declarator(MemoryState &state, const QueryMatch &match) {
+    uint32_t id = state.intern(match.capture(memory_captures().declarator));
+    if (id >= state.recursion_count.size()) state.recursion_count.resize(id + 1);
+    if (state.recursion_count[id]++ == 0) state.declared_functions.push_back(id);
+}
+
+void on_subscript_expression(MemoryState &state, const QueryMatch &) {
+    state.uses_dp_table = true;
+}
+
+using MatchHandler = void (*)(MemoryState &, const QueryMatch &);
+
+// One handler per pattern, in pattern order: a match's pattern index is its
+// handler's index.
+struct MemoryRule {
+    const char *pattern;
+    MatchHandler handler;
+};
+
+const MemoryRule memory_rules[] = {
+    {"(init_declarator declarator: (_) @declarator value: (_) @value)", on_initialization},
+    {"(assignment_expression left: (identifier) @declarator operator: \"=\" right: (_) @value)", on_assignment},
+    {"(delete_expression [(identifier) (field_expression) (subscript_expression)] @target)", on_delete_expression},
+    {"(call_expression function: (_) @function) @call", on_call_expression},
+    {"(return_statement (identifier) @target)", on_return},
+    {"(declaration declarator: (_) @declarator)", on_declaration},
+    {"(function_definition body: (compound_statement) @body)", on_function_body},
+    {"(function_declarator declarator: (_) @declarator)", on_function_declarator},
+    {"(subscript_expression) @target", on_subscript_expression},
+};
+
+const std::string &memory_query() {
+    static const std::string source = [] {
+        std::string text;
+        for (const MemoryRule &rule : memory_rules) text.append(rule.pattern).append("\n");
+        return text;
+    }();
+    return source;
+}
+
+const MemoryCaptures &memory_captures() {
+    static const MemoryCaptures captures = [] {
+        const Query &query = shared_query(memory_query());
+        return MemoryCaptures{query.capture_id("declarator"), query.capture_id("value"),
+                              query.capture_id("function"), query.capture_id("target"),
+                              query.capture_id("call"), query.capture_id("body")};
+    }();
+    return captures;
+}
+
+const uint32_t no_function = UINT32_MAX;
+
+// Innermost body containing each position of `bytes` (sorted), or
+// no_function. `bodies` must be sorted by start; bodies nest or are disjoint.
+template <class Byte>
+std::pmr::vector<uint32_t> owning_bodies(const std::pmr::vector<TSNode> &bodies, size_t count, Byte byte) {
+    std::pmr::memory_resource *memory = bodies.get_allocator().resource();
+    std::pmr::vector<uint32_t> owners(count, no_function, memory);
+    std::pmr::vector<uint32_t> open(memory);
+    size_t next = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t position = byte(i);
+        while (next < bodies.size() && ts_node_start_byte(bodies[next]) <= position) {
+            while (!open.empty() && ts_node_end_byte(bodies[open.back()]) <= ts_node_start_byte(bodies[next])) open.pop_back();
+            open.push_back(static_cast<uint32_t>(next++));
+        }
+        while (!open.empty() && ts_node_end_byte(bodies[open.back()]) <= position) open.pop_back();
+        if (!open.empty()) owners[i] = open.back();
+    }
+    return owners;
+}
+
+// Per-name scratch for check_function, indexed by interned id and reused
+// across the functions of one run.
+struct FunctionScratch {
+    std::pmr::vector<uint32_t> local_stamp; // stamp of the function declaring the name
+    std::pmr::vector<uint32_t> index;       // dense variable number in the current function
+};
+
+// Runs the ownership dataflow over one function (`events` index state.events,
+// `stamp` marks its locals in scratch.local_stamp). Variables declared in the
+// body are fully tracked; anything else (parameters, globals, members) may be
+// owned elsewhere, so it is only checked for double frees, and for frees of
+// names that are never allocated anywhere in the file.
+void check_function(MemoryState &state, TSNode body, const std::pmr::vector<uint32_t> &events, uint32_t stamp,
+                    FunctionScratch &scratch, const std::pmr::vector<bool> &allocated_anywhere,
+                    std::pmr::vector<LocatedWarning> &warnings) {
+    std::pmr::vector<uint32_t> names(state.memory);
+    std::pmr::vector<PointerEvent> flow_events(state.memory);
+    flow_events.reserve(events.size());
+    for (uint32_t e : events) {
+        const MemoryEvent &event = state.events[e];
+        uint32_t &index = scratch.index[event.variable];
+        if (index == StringInterner::none) {
+            index = static_cast<uint32_t>(names.size());
+            names.push_back(event.variable);
+        }
+        flow_events.push_back({event.kind, event.byte, index});
+    }
+    std::pmr::vector<bool> track_leaks(names.size(), false, state.memory);
+    for (size_t v = 0; v < names.size(); v++) {
+        track_leaks[v] = scratch.local_stamp[names[v]] == stamp;
+        scratch.index[names[v]] = StringInterner::none;
+    }
+
+    FlowGraph graph = build_flow_graph(body, state.code);
+    for (const PointerIssue &issue : analyze_pointers(graph, flow_events, static_cast<uint32_t>(names.size()), track_leaks)) {
+        const PointerEvent &event = flow_events[issue.event];
+        uint32_t id = names[issue.variable];
+        std::string name(state.strings.view(id));
+        bool deletes = event.kind == PointerEvent::Delete;
+        switch (issue.kind) {
+        case PointerIssue::DoubleFree:
+            warnings.push_back({event.byte, deletes ? "Use-after-free detected: Attempt to delete already freed pointer " + name
+                                                    : "Use-after-free detected: " + name});
+            break;
+        case PointerIssue::NeverOwned:
+            if (!track_leaks[issue.variable] && allocated_anywhere[id]) break;
+            warnings.push_back({event.byte, deletes ? "Deleting a pointer that was never allocated: " + name
+                                                    : "Deallocating unallocated pointer: " + name});
+            break;
+        case PointerIssue::Leak: {
+            int count = 0;
+            for (const PointerEvent &e : flow_events) count += e.variable == issue.variable && e.kind == PointerEvent::Allocate;
+            state.leaks.push_back({event.byte, "Potential memory leak: Variable `" + name + "` allocated " +
+                                                   std::to_string(count) + " times without corresponding deallocation."});
+            break;
+        }
+        }
+    }
+}
+
+} // namespace
+
+MemoryChecker::MemoryChecker(AnalysisResult &result, StringInterner *strings)
+    : result_(result), own_strings_(strings ? nullptr : new StringInterner()),
+      strings_(strings ? strings : own_strings_.get()) {}
+
+MemoryChecker::~MemoryChecker() = default;
+
+std::vector<TSSymbol> MemoryChecker::subscriptions(const CppGrammar &) const {
+    return {};
+}
+
+std::string_view MemoryChecker::query() const {
+    return memory_query();
+}
+
+void MemoryChecker::begin(std::string_view code) {
+    state_ = std::make_unique<MemoryState>(code, *strings_);
+}
+
+Visit MemoryChecker::match(const QueryMatch &match) {
+    memory_rules[match.pattern].handler(*state_, match);
+    return Visit::Continue;
+}
+
+void MemoryChecker::finish() {
+    MemoryState &state = *state_;
+    const StringInterner &strings = state.strings;
+    auto by_byte = [](const auto &a, const auto &b) { return a.byte < b.byte; };
+    std::stable_sort(state.events.begin(), state.events.end(), by_byte);
+    std::sort(state.locals.begin(), state.locals.end(), by_byte);
+    std::sort(state.bodies.begin(), state.bodies.end(), [](TSNode a, TSNode b) {
+        return ts_node_start_byte(a) < ts_node_start_byte(b);
+    });
+
+    std::pmr::memory_resource *memory = state.memory;
+    std::pmr::vector<uint32_t> event_owner = owning_bodies(state.bodies, state.events.size(),
+                                                           [&](size_t i) { return state.events[i].byte; });
+    std::pmr::vector<uint32_t> local_owner = owning_bodies(state.bodies, state.locals.size(),
+                                                           [&](size_t i) { return state.locals[i].byte; });
+    std::pmr::vector<std::pmr::vector<uint32_t>> body_locals(state.bodies.size(), memory);
+    for (size_t i = 0; i < state.locals.size(); i++) {
+        if (local_owner[i] != no_function) body_locals[local_owner[i]].push_back(state.locals[i].variable);
+    }
+    std::pmr::vector<bool> allocated_anywhere(strings.size(), false, memory);
+    std::pmr::vector<std::pmr::vector<uint32_t>> body_events(state.bodies.size(), memory);
+    for (uint32_t i = 0; i < state.events.size(); i++) {
+        const MemoryEvent &event = state.events[i];
+        if (event.kind == PointerEvent::Allocate) allocated_anywhere[event.variable] = true;
+        if (event_owner[i] != no_function) body_events[event_owner[i]].push_back(i);
+    }
+    // A name may be allocated in the part of the file that was not walked.
+    bool cut = partial_ || budget_expired();
+    if (cut) allocated_anywhere.assign(strings.size(), true);
+
+    std::pmr::vector<LocatedWarning> warnings(memory);
+    for (uint32_t byte : state.greedy_calls) {
+        warnings.push_back({byte, "Possible greedy approach detected. Consider DP if optimization is needed."});
+    }
+    FunctionScratch scratch{std::pmr::vector<uint32_t>(strings.size(), 0, memory),
+                            std::pmr::vector<uint32_t>(strings.size(), StringInterner::none, memory)};
+    std::pmr::vector<bool> event_local(state.events.size(), false, memory);
+    for (uint32_t f = 0; f < state.bodies.size(); f++) {
+        uint32_t stamp = f + 1;
+        for (uint32_t id : body_locals[f]) scratch.local_stamp[id] = stamp;
+        for (uint32_t i : body_events[f]) event_local[i] = scratch.local_stamp[state.events[i].variable] == stamp;
+        if (!body_events[f].empty() && !budget_expired()) {
+            check_function(state, state.bodies[f], body_events[f], stamp, scratch, allocated_anywhere, warnings);
+        }
+    }
+
+    // Names that are not local to the function they are used in keep the
+    // file-wide allocation/deallocation balance. Frees outside any function
+    // body have no flow to follow. Neither means anything for part of a file.
+    std::pmr::vector<int> allocation_count(strings.size(), 0, memory);
+    std::pmr::vector<int> deallocation_count(strings.size(), 0, memory);
+    std::pmr::vector<uint32_t> shared_order(memory);
+    for (size_t i = 0; i < state.events.size() && !cut; i++) {
+        const MemoryEvent &event = state.events[i];
+        if (event_local[i]) continue;
+        bool frees = event.kind == PointerEvent::Free || event.kind == PointerEvent::Delete;
+        if (event.kind == PointerEvent::Allocate) {
+            if (allocation_count[event.variable]++ == 0) shared_order.push_back(event.variable);
+        } else if (frees) {
+            deallocation_count[event.variable]++;
+        }
+        if (frees && event_owner[i] == no_function && !allocated_anywhere[event.variable]) {
+            std::string name(strings.view(event.variable));
+            warnings.push_back({event.byte, event.kind == PointerEvent::Delete
+                                                ? "Deleting a pointer that was never allocated: " + name
+                                                : "Deallocating unallocated pointer: " + name});
+        }
+    }
+    std::stable_sort(warnings.begin(), warnings.end(), by_byte);
+    for (LocatedWarning &warning : warnings) result_.add_warning(warning.text);
+
+    std::stable_sort(state.leaks.begin(), state.leaks.end(), by_byte);
+    for (LocatedWarning &leak : state.leaks) result_.add_warning(leak.text);
+    for (uint32_t id : shared_order) {
+        int count = allocation_count[id];
+        if (deallocation_count[id] < count) {
+            result_.add_warning("Potential memory leak: Variable `" + std::string(strings.view(id)) + "` allocated " +
+                                std::to_string(count) + " times without corresponding deallocation.");
+        }
+    }
+
+    for (uint32_t id : state.declared_functions) {
+        if (state.recursion_count[id] > 1 && state.uses_dp_table) {
+            result_.add_warning("Dynamic Programming detected: Recursive function `" + std::string(strings.view(id)) +
+                                "` combined with table usage.");
+        }
+    }
+    state_.reset();
+}
+
+// End of the longest run of top-level declarations that fits in `limit`
+// nodes, so an oversized file is still analyzed up to a declaration boundary.
+static uint32_t node_budget_end(TSNode root, uint64_t limit) {
+    uint64_t nodes = 1;
+    uint32_t end = UINT32_MAX;
+    for_each_child(root, [&](TSNode child) {
+        nodes += ts_node_descendant_count(child);
+        if (nodes > limit && end == UINT32_MAX) end = ts_node_start_byte(child);
+    });
+    return end;
+}
+
+void analyze_code(TSParser *parser, std::string_view code, AnalysisResult &result,
+                  const AnalysisOptions &options) {
+    // Built first: bad rules throw before anything needs cleaning up.
+    std::unique_ptr<RuleChecker> rules;
+    if (!options.rules.empty()) rules = std::make_unique<RuleChecker>(options.rules, result);
+    if (Metrics *metrics = current_metrics()) metrics->bytes += code.size();
+    TSTree *tree;
+    {
+        PhaseTimer timer(phase_parse);
+        tree = parse_source(parser, nullptr, code);
+    }
+    if (!tree) {
+        result.incomplete = "parse exceeded the time budget";
+        return;
+    }
+    TSNode root_node = ts_tree_root_node(tree);
+    uint32_t end_byte = UINT32_MAX;
+    if (uint64_t limit = budget_node_limit()) end_byte = node_budget_end(root_node, limit);
+
+    CheckerPipeline pipeline;
+    StringInterner strings;
+    MemoryChecker memory(result, &strings);
+    memory.set_partial(end_byte != UINT32_MAX);
+    FunctionChecker functions(result.functions, &strings);
+    ReturnValueChecker returns(options.return_function, result.return_values);
+    ReturnSummaryChecker summaries(result.return_summaries);
+    if (options.memory) pipeline.add(memory);
+    if (options.functions) pipeline.add(functions);
+    if (!options.return_function.empty()) pipeline.add(returns);
+    if (options.return_summaries) pipeline.add(summaries);
+    if (rules) pipeline.add(*rules);
+    pipeline.run(root_node, code, 0, end_byte);
+
+    if (budget_expired()) {
+        result.incomplete = "analysis exceeded the time budget";
+    } else if (end_byte != UINT32_MAX) {
+        result.incomplete = "node budget exceeded; analyzed the first " + std::to_string(end_byte) + " of " +
+                            std::to_string(code.size()) + " bytes";
+    }
+    ts_tree_delete(tree);
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include "common.h"
+#include "checker.h"
+#include "functions.h"
+#include "returnv.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+// Which checkers analyze_code runs in its single traversal.
+struct AnalysisOptions {
+    bool memory = true;           // leak / use-after-free / DP heuristics
+    bool functions = false;       // function cross-reference table
+    std::string return_function;  // collect this function's return value when non-empty
+    bool return_summaries = false; // first return value of every function definition
+    std::string rules;            // user rule patterns (see RuleChecker), none when empty
+};
+
+struct AnalysisResult {
+    std::vector<std::string> warnings;
+    std::vector<FunctionInfo> functions;
+    std::vector<std::string> return_values;
+    std::vector<ReturnSummary> return_summaries; // sorted by qualified name
+    std::string incomplete; // why analysis stopped early (see budget.h); empty when it covered the whole file
+    void add_warning(const std::string &msg) {
+        warnings.push_back(msg);
+    }
+};
+
+struct MemoryState;
+
+// Memory-leak / use-after-free / DP heuristics, written as query patterns
+// with one handler each. The handlers only record pointer events; when the
+// run finishes, each function body's events are checked by a dataflow pass
+// over its control-flow graph (see dataflow.h) and the warnings are appended
+// to the result passed at construction.
+class MemoryChecker : public Checker {
+public:
+    // Names are interned in `strings`, or in a private interner when none is given.
+    explicit MemoryChecker(AnalysisResult &result, StringInterner *strings = nullptr);
+    ~MemoryChecker() override;
+
+    std::vector<TSSymbol> subscriptions(const CppGrammar &g) const override;
+    std::string_view query() const override;
+    void begin(std::string_view code) override;
+    Visit match(const QueryMatch &match) override;
+    void finish() override;
+
+    // The run covers only part of the file (a node budget cut it short). As
+    // when the time budget runs out, checks that need every use of a name in
+    // the file are then skipped rather than reported on partial evidence.
+    void set_partial(bool partial) { partial_ = partial; }
+
+private:
+    AnalysisResult &result_;
+    bool partial_ = false;
+    std::unique_ptr<StringInterner> own_strings_;
+    StringInterner *strings_;
+    std::unique_ptr<MemoryState> state_;
+};
+
+// Parses `code` once and runs every checker enabled in `options` over the
+// tree in one fused traversal. `parser` must already have the C++ language
+// set; it is reused across calls so workers only pay for its construction once.
+// Under a BudgetScope, stops early once the budget is spent and says why in
+// `result.incomplete`; whatever was found before that is kept.
+void analyze_code(TSParser *parser, std::string_view code, AnalysisResult &result,
+                  const AnalysisOptions &options = AnalysisOptions());
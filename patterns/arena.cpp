@@ -0,0 +1,102 @@
+#include "arena.h"
+#include "instrument.h"
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <tree_sitter/api.h>
+
+static thread_local Arena *current_arena = nullptr;
+
+Arena::Arena(size_t initial_size)
+    : initial_(new char[initial_size]), buffer_(initial_.get(), initial_size) {}
+
+ArenaScope::ArenaScope(Arena *arena) : previous_(current_arena) {
+    current_arena = arena;
+}
+
+ArenaScope::~ArenaScope() {
+    current_arena = previous_;
+}
+
+std::pmr::memory_resource *analysis_memory() {
+    return current_arena ? current_arena->resource() : std::pmr::get_default_resource();
+}
+
+namespace {
+
+// Keeps the payload aligned for any type, like malloc.
+struct alignas(alignof(std::max_align_t)) BlockHeader {
+    size_t size;
+    Arena *owner; // null for malloc'd blocks
+};
+
+BlockHeader *header_of(void *ptr) {
+    return static_cast<BlockHeader *>(ptr) - 1;
+}
+
+// Tree-sitter is C and expects its allocator to abort rather than throw.
+void *allocate_block(Arena *owner, size_t size) {
+    void *memory = nullptr;
+    if (owner) {
+        try {
+            memory = owner->resource()->allocate(sizeof(BlockHeader) + size, alignof(BlockHeader));
+        } catch (...) {
+        }
+    } else {
+        note_allocation();
+        memory = std::malloc(sizeof(BlockHeader) + size);
+    }
+    if (!memory) {
+        fprintf(stderr, "Error: out of memory allocating %zu bytes\n", size);
+        std::abort();
+    }
+    BlockHeader *header = static_cast<BlockHeader *>(memory);
+    header->size = size;
+    header->owner = owner;
+    return header + 1;
+}
+
+void *arena_malloc(size_t size) {
+    return allocate_block(current_arena, size);
+}
+
+void *arena_calloc(size_t count, size_t size) {
+    if (size != 0 && count > SIZE_MAX / size) {
+        fprintf(stderr, "Error: out of memory allocating %zu blocks of %zu bytes\n", count, size);
+        std::abort();
+    }
+    void *ptr = allocate_block(current_arena, count * size);
+    memset(ptr, 0, count * size);
+    return ptr;
+}
+
+// A block stays with its owner: tree-sitter grows arrays by realloc, and a
+// heap array grown while an arena is current must stay on the heap.
+void *arena_realloc(void *ptr, size_t size) {
+    if (!ptr) return arena_malloc(size);
+    BlockHeader *header = header_of(ptr);
+    if (!header->owner) {
+        note_allocation();
+        BlockHeader *grown = static_cast<BlockHeader *>(std::realloc(header, sizeof(BlockHeader) + size));
+        if (!grown) {
+            fprintf(stderr, "Error: out of memory allocating %zu bytes\n", size);
+            std::abort();
+        }
+        grown->size = size;
+        return grown + 1;
+    }
+    if (size <= header->size) return ptr;
+    void *grown = allocate_block(header->owner, size);
+    memcpy(grown, ptr, header->size);
+    return grown;
+}
+
+void arena_free(void *ptr) {
+    if (ptr && !header_of(ptr)->owner) std::free(header_of(ptr));
+}
+
+} // namespace
+
+void install_arena_allocator() {
+    ts_set_allocator(arena_malloc, arena_calloc, arena_realloc, arena_free);
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "common.h"
+#include <memory>
+#include <memory_resource>
+
+// Bump allocator for everything one file's analysis allocates: the tree
+// and parser internals (through install_arena_allocator) and the analysis
+// containers that take their memory from analysis_memory(). Frees are no-ops;
+// release() drops the lot at once when the file is done.
+//
+// Opt-in and single-threaded: each worker thread owns one arena and makes it
+// current with an ArenaScope around one file at a time. Nothing allocated
+// inside the scope may outlive the following release(); in particular the
+// parser must be created and deleted inside it.
+class Arena {
+public:
+    // `initial_size` bytes are allocated once and reused by every file;
+    // larger files grow the arena geometrically until the next release.
+    explicit Arena(size_t initial_size = 1 << 20);
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    std::pmr::memory_resource *resource() { return &buffer_; }
+
+    void release() { buffer_.release(); }
+
+private:
+    std::unique_ptr<char[]> initial_;
+    std::pmr::monotonic_buffer_resource buffer_;
+};
+
+// Routes tree-sitter's allocator through hooks that serve the calling
+// thread's current arena, falling back to malloc outside any ArenaScope.
+// Every block carries a small header naming its owner, so blocks from either
+// source can be freed or reallocated anywhere. Replaces
+// count_tree_sitter_allocations() (only malloc calls are counted) and must
+// run before tree-sitter allocates anything.
+void install_arena_allocator();
+
+// Makes `arena` the calling thread's current arena for the lifetime of the
+// scope; null suspends the current one, for objects that outlive a file
+// (compiled queries, for example).
+class ArenaScope {
+public:
+    explicit ArenaScope(Arena *arena);
+    ~ArenaScope();
+    ArenaScope(const ArenaScope &) = delete;
+    ArenaScope &operator=(const ArenaScope &) = delete;
+
+private:
+    Arena *previous_;
+};
+
+// Memory resource for per-file analysis containers: the current arena, or
+// the default resource when none is active.
+std::pmr::memory_resource *analysis_memory();
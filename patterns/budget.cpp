@@ -0,0 +1,26 @@
+#include "budget.h"
+#include "instrument.h"
+
+static thread_local BudgetScope::State *thread_budget = nullptr;
+
+BudgetScope::BudgetScope(const Budget *budget) : active_(budget != nullptr), state_{0, 0, false}, previous_(thread_budget) {
+    if (!active_) return;
+    state_.deadline_nanos = budget->time_micros ? monotonic_nanos() + budget->time_micros * 1000 : 0;
+    state_.node_limit = budget->node_limit;
+    thread_budget = &state_;
+}
+
+BudgetScope::~BudgetScope() {
+    if (active_) thread_budget = previous_;
+}
+
+bool budget_expired() {
+    BudgetScope::State *budget = thread_budget;
+    if (!budget || !budget->deadline_nanos) return false;
+    if (!budget->expired && monotonic_nanos() >= budget->deadline_nanos) budget->expired = true;
+    return budget->expired;
+}
+
+uint64_t budget_node_limit() {
+    return thread_budget ? thread_budget->node_limit : 0;
+}
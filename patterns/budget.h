@@ -0,0 +1,41 @@
+#pragma once
+#include "common.h"
+
+// Per-file limits on parse and analysis work, so that one minified or
+// generated file cannot stall a worker. Zero means unlimited.
+struct Budget {
+    uint64_t time_micros = 0; // wall time for parse + analysis, from the start of the scope
+    uint64_t node_limit = 0;  // syntax nodes analyzed; a larger tree is analyzed up to the limit
+};
+
+// Makes `budget` the calling thread's budget for the lifetime of the scope,
+// like MetricsScope. Does nothing if `budget` is null. parse_source(), query
+// cursors, the checker walk and the memory checker's per-function dataflow
+// poll it and stop early once it is spent.
+class BudgetScope {
+public:
+    explicit BudgetScope(const Budget *budget);
+    ~BudgetScope();
+    BudgetScope(const BudgetScope &) = delete;
+    BudgetScope &operator=(const BudgetScope &) = delete;
+
+    // What the polling functions below read; not for direct use.
+    struct State {
+        uint64_t deadline_nanos; // 0 when there is no time limit
+        uint64_t node_limit;
+        bool expired;
+    };
+
+private:
+    bool active_;
+    State state_;
+    State *previous_;
+};
+
+// True once the calling thread's time budget is spent, and from then on for
+// the rest of the scope. Cheap enough for hot loops; always false without a
+// budget.
+bool budget_expired();
+
+// Node limit of the calling thread's budget, 0 when unlimited.
+uint64_t budget_node_limit();
@@ -0,0 +1,203 @@
+#include "cache.h"
+#include "version.h"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+static const char cache_magic[4] = {'C', 'P', 'R', 'C'};
+static const uint32_t cache_format = 3;
+
+// MurmurHash64A, run as two lanes over the same words in one pass.
+ContentHash content_hash(std::string_view data) {
+    const uint64_t m = 0xc6a4a7935bd1e995ULL;
+    const int r = 47;
+    uint64_t h1 = 0x243f6a8885a308d3ULL ^ (data.size() * m);
+    uint64_t h2 = 0x13198a2e03707344ULL ^ (data.size() * m);
+    const char *p = data.data();
+    const char *end = p + (data.size() & ~size_t(7));
+    for (; p != end; p += 8) {
+        uint64_t k;
+        memcpy(&k, p, sizeof(k));
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h1 = (h1 ^ k) * m;
+        h2 = (h2 ^ (k + 0x9e3779b97f4a7c15ULL)) * m;
+    }
+    uint64_t tail = 0;
+    for (size_t i = 0; i < (data.size() & 7); i++) {
+        tail |= uint64_t(static_cast<unsigned char>(p[i])) << (8 * i);
+    }
+    if (data.size() & 7) {
+        h1 = (h1 ^ tail) * m;
+        h2 = (h2 ^ (tail + 0x9e3779b97f4a7c15ULL)) * m;
+    }
+    h1 ^= h1 >> r;
+    h1 *= m;
+    h1 ^= h1 >> r;
+    h2 ^= h2 >> r;
+    h2 *= m;
+    h2 ^= h2 >> r;
+    return {h1, h2};
+}
+
+static void hex64(std::string &out, uint64_t value) {
+    static const char digits[] = "0123456789abcdef";
+    for (int shift = 60; shift >= 0; shift -= 4) out.push_back(digits[(value >> shift) & 15]);
+}
+
+static void put_u32(std::string &out, uint32_t value) {
+    out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static void put_string(std::string &out, const std::string &value) {
+    put_u32(out, static_cast<uint32_t>(value.size()));
+    out.append(value);
+}
+
+// Bounds-checked reader over a loaded entry; any overrun marks it corrupt.
+struct EntryReader {
+    std::string_view data;
+    bool ok = true;
+
+    uint32_t u32() {
+        uint32_t value = 0;
+        if (data.size() < sizeof(value)) { ok = false; return 0; }
+        memcpy(&value, data.data(), sizeof(value));
+        data.remove_prefix(sizeof(value));
+        return value;
+    }
+    std::string string() {
+        uint32_t size = u32();
+        if (!ok || data.size() < size) { ok = false; return std::string(); }
+        std::string value(data.substr(0, size));
+        data.remove_prefix(size);
+        return value;
+    }
+};
+
+ResultCache::ResultCache(const std::string &directory) : directory_(directory) {}
+
+std::string ResultCache::key(std::string_view source, const AnalysisOptions &options) const {
+    std::string config = CPPREVIEWER_VERSION;
+    config += options.memory ? "|memory" : "|";
+    config += options.functions ? "|functions" : "|";
+    config += "|returns:" + options.return_function;
+    config += options.return_summaries ? "|summaries" : "|";
+    config += "|rules:" + options.rules;
+
+    ContentHash content = content_hash(source);
+    std::string key;
+    hex64(key, content.low);
+    hex64(key, content.high);
+    key.push_back('-');
+    hex64(key, content_hash(config).low);
+    return key;
+}
+
+std::string ResultCache::entry_path(const std::string &key) const {
+    return (std::filesystem::path(directory_) / key.substr(0, 2) / key).string();
+}
+
+bool ResultCache::load(const std::string &key, AnalysisResult &result) {
+    std::ifstream in(entry_path(key), std::ios::binary);
+    if (!in) {
+        misses_++;
+        return false;
+    }
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    std::string bytes = ss.str();
+
+    EntryReader reader{bytes};
+    AnalysisResult loaded;
+    bool ok = bytes.size() >= sizeof(cache_magic) && memcmp(bytes.data(), cache_magic, sizeof(cache_magic)) == 0;
+    if (ok) {
+        reader.data.remove_prefix(sizeof(cache_magic));
+        ok = reader.u32() == cache_format;
+    }
+    if (ok) {
+        for (uint32_t n = reader.u32(); reader.ok && n > 0; n--) loaded.warnings.push_back(reader.string());
+        for (uint32_t n = reader.u32(); reader.ok && n > 0; n--) {
+            FunctionInfo info;
+            info.name = reader.string();
+            info.declaration = reader.string();
+            loaded.functions.push_back(std::move(info));
+        }
+        for (uint32_t n = reader.u32(); reader.ok && n > 0; n--) loaded.return_values.push_back(reader.string());
+        for (uint32_t n = reader.u32(); reader.ok && n > 0; n--) {
+            ReturnSummary summary;
+            summary.name = reader.string();
+            summary.value = reader.string();
+            summary.start_byte = reader.u32();
+            summary.returns = reader.u32() != 0;
+            summary.type = reader.string();
+            summary.constant.status = static_cast<ConstantValue::Status>(reader.u32());
+            summary.constant.type.bits = static_cast<uint8_t>(reader.u32());
+            summary.constant.type.is_unsigned = reader.u32() != 0;
+            summary.constant.bits = reader.u32();
+            summary.constant.bits |= uint64_t(reader.u32()) << 32;
+            summary.forward = reader.string();
+            for (uint32_t calls = reader.u32(); reader.ok && calls > 0; calls--) summary.calls.push_back(reader.string());
+            loaded.return_summaries.push_back(std::move(summary));
+        }
+        ok = reader.ok && reader.data.empty();
+    }
+    if (!ok) {
+        misses_++;
+        return false;
+    }
+    result = std::move(loaded);
+    hits_++;
+    return true;
+}
+
+void ResultCache::store(const std::string &key, const AnalysisResult &result) {
+    std::string bytes(cache_magic, sizeof(cache_magic));
+    put_u32(bytes, cache_format);
+    put_u32(bytes, static_cast<uint32_t>(result.warnings.size()));
+    for (const std::string &warning : result.warnings) put_string(bytes, warning);
+    put_u32(bytes, static_cast<uint32_t>(result.functions.size()));
+    for (const FunctionInfo &info : result.functions) {
+        put_string(bytes, info.name);
+        put_string(bytes, info.declaration);
+    }
+    put_u32(bytes, static_cast<uint32_t>(result.return_values.size()));
+    for (const std::string &value : result.return_values) put_string(bytes, value);
+    put_u32(bytes, static_cast<uint32_t>(result.return_summaries.size()));
+    for (const ReturnSummary &summary : result.return_summaries) {
+        put_string(bytes, summary.name);
+        put_string(bytes, summary.value);
+        put_u32(bytes, summary.start_byte);
+        put_u32(bytes, summary.returns);
+        put_string(bytes, summary.type);
+        put_u32(bytes, summary.constant.status);
+        put_u32(bytes, summary.constant.type.bits);
+        put_u32(bytes, summary.constant.type.is_unsigned);
+        put_u32(bytes, static_cast<uint32_t>(summary.constant.bits));
+        put_u32(bytes, static_cast<uint32_t>(summary.constant.bits >> 32));
+        put_string(bytes, summary.forward);
+        put_u32(bytes, static_cast<uint32_t>(summary.calls.size()));
+        for (const std::string &callee : summary.calls) put_string(bytes, callee);
+    }
+
+    // A failed store only costs a future miss, so errors are swallowed.
+    std::error_code error;
+    std::filesystem::path path = entry_path(key);
+    std::filesystem::create_directories(path.parent_path(), error);
+    std::string temp = path.string() + ".tmp";
+    hex64(temp, std::hash<std::thread::id>()(std::this_thread::get_id()) ^
+                    static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count()));
+    hex64(temp, temp_counter_++);
+    {
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        if (!out.write(bytes.data(), bytes.size())) {
+            out.close();
+            std::filesystem::remove(temp, error);
+            return;
+        }
+    }
+    std::filesystem::rename(temp, path, error);
+    if (error) std::filesystem::remove(temp, error);
+}
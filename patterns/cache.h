@@ -0,0 +1,42 @@
+#pragma once
+#include "common.h"
+#include "analyzer.h"
+#include <atomic>
+#include <string>
+
+// 128-bit content hash (two MurmurHash64A lanes with different seeds).
+struct ContentHash {
+    uint64_t low;
+    uint64_t high;
+};
+ContentHash content_hash(std::string_view data);
+
+// Content-addressed on-disk store of analysis results. The key covers the
+// source bytes, CPPREVIEWER_VERSION and the enabled checkers, so a warm run
+// over an unchanged tree only hashes files. Entries live in
+// `<directory>/<first two hex digits>/<key>` and are written to a temporary
+// file first and renamed, so concurrent workers or CI shards sharing the
+// directory never see half-written entries. Unreadable or corrupt entries
+// count as misses. load() and store() may be called from several threads.
+class ResultCache {
+public:
+    explicit ResultCache(const std::string &directory);
+
+    // Cache key for `source` analyzed with `options`.
+    std::string key(std::string_view source, const AnalysisOptions &options) const;
+
+    // Fills `result` and returns true on a hit.
+    bool load(const std::string &key, AnalysisResult &result);
+    void store(const std::string &key, const AnalysisResult &result);
+
+    size_t hits() const { return hits_; }
+    size_t misses() const { return misses_; }
+
+private:
+    std::string entry_path(const std::string &key) const;
+
+    std::string directory_;
+    std::atomic<size_t> hits_{0};
+    std::atomic<size_t> misses_{0};
+    std::atomic<size_t> temp_counter_{0};
+};
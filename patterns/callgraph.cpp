@@ -0,0 +1,274 @@
+#include "callgraph.h"
+#include "worker_pool.h"
+#include <iomanip>
+
+// Levels with fewer components than this are solved on the calling thread;
+// starting workers would cost more than the components do.
+static const size_t parallel_threshold = 64;
+
+ConstantValue returned_constant(const ConstantValue &value, std::string_view type) {
+    if (!value.known()) return value;
+    ConstantValue converted = cast_constant(value, type);
+    if (converted.known()) return converted;
+    bool deduced = type.find("auto") != std::string_view::npos && type.find_first_of("*&") == std::string_view::npos;
+    return deduced ? value : ConstantValue();
+}
+
+void CallGraph::set_file(const std::string &path, std::vector<ReturnSummary> summaries) {
+    files_[path] = std::move(summaries);
+    dirty_ = true;
+}
+
+void CallGraph::remove_file(const std::string &path) {
+    dirty_ |= files_.erase(path) != 0;
+}
+
+const ResolvedReturn *CallGraph::find(std::string_view name) const {
+    auto found = std::lower_bound(results_.begin(), results_.end(), name,
+                                  [](const ResolvedReturn &result, std::string_view key) { return result.name < key; });
+    return found != results_.end() && found->name == name ? &*found : nullptr;
+}
+
+// Tries `callee` in the scopes enclosing `caller`, innermost first; a leading
+// `::` asks for the global one only.
+uint32_t CallGraph::lookup(std::string_view caller, std::string_view callee) const {
+    std::string_view scope;
+    if (callee.substr(0, 2) == "::") {
+        callee.remove_prefix(2);
+    } else {
+        size_t cut = caller.rfind("::");
+        scope = cut == std::string_view::npos ? std::string_view() : caller.substr(0, cut + 2);
+    }
+    std::string candidate;
+    for (;;) {
+        candidate.assign(scope.data(), scope.size()).append(callee.data(), callee.size());
+        auto found = first_.find(candidate);
+        if (found != first_.end()) return found->second;
+        if (scope.empty()) return none;
+        scope.remove_suffix(2);
+        size_t cut = scope.rfind("::");
+        scope = cut == std::string_view::npos ? std::string_view() : scope.substr(0, cut + 2);
+    }
+}
+
+// Numbers every function, indexes them by name and resolves each call to
+// its targets. Name lookups only read the index, so they run in parallel.
+void CallGraph::link(unsigned jobs) {
+    nodes_.clear();
+    for (const auto &file : files_) {
+        for (const ReturnSummary &summary : file.second) nodes_.push_back({&summary, &file.first});
+    }
+    uint32_t count = static_cast<uint32_t>(nodes_.size());
+    first_.clear();
+    first_.reserve(count);
+    next_.assign(count, none);
+    // Backwards, so every chain lists overloads in source order.
+    for (uint32_t i = count; i-- > 0;) {
+        auto inserted = first_.emplace(nodes_[i].summary->name, i);
+        if (!inserted.second) {
+            next_[i] = inserted.first->second;
+            inserted.first->second = i;
+        }
+    }
+
+    std::vector<std::vector<uint32_t>> calls(count);
+    forward_.assign(count, none);
+    parallel_for(count, jobs, [&](size_t i, unsigned) {
+        const ReturnSummary &summary = *nodes_[i].summary;
+        for (const std::string &callee : summary.calls) {
+            for (uint32_t target = lookup(summary.name, callee); target != none; target = next_[target]) {
+                calls[i].push_back(target);
+            }
+        }
+        if (summary.forward.empty()) return;
+        // Normally among the calls already; added again in case it is not,
+        // since the order must put what a function forwards to first.
+        forward_[i] = lookup(summary.name, summary.forward);
+        for (uint32_t target = forward_[i]; target != none; target = next_[target]) calls[i].push_back(target);
+    });
+    edge_start_.assign(1, 0);
+    targets_.clear();
+    for (std::vector<uint32_t> &list : calls) {
+        targets_.insert(targets_.end(), list.begin(), list.end());
+        edge_start_.push_back(static_cast<uint32_t>(targets_.size()));
+    }
+}
+
+// Tarjan's algorithm with an explicit stack of (node, next edge) frames, so
+// call chains of any length fit. Components come out callees first; each
+// one's level is one above the highest level among the components it calls.
+void CallGraph::order() {
+    uint32_t count = static_cast<uint32_t>(nodes_.size());
+    struct Frame {
+        uint32_t node;
+        uint32_t edge;
+    };
+    std::vector<uint32_t> index(count, none), low(count);
+    std::vector<bool> on_stack(count);
+    std::vector<uint32_t> stack;
+    std::vector<Frame> frames;
+    uint32_t counter = 0;
+    component_.assign(count, none);
+    position_.assign(count, none);
+    component_start_.assign(1, 0);
+    members_.clear();
+    members_.reserve(count);
+
+    auto visit = [&](uint32_t node) {
+        index[node] = low[node] = counter++;
+        stack.push_back(node);
+        on_stack[node] = true;
+        frames.push_back({node, edge_start_[node]});
+    };
+    for (uint32_t root = 0; root < count; root++) {
+        if (index[root] != none) continue;
+        visit(root);
+        while (!frames.empty()) {
+            uint32_t node = frames.back().node;
+            if (frames.back().edge < edge_start_[node + 1]) {
+                uint32_t target = targets_[frames.back().edge++];
+                if (index[target] == none) {
+                    visit(target);
+                } else if (on_stack[target]) {
+                    low[node] = std::min(low[node], index[target]);
+                }
+                continue;
+            }
+            frames.pop_back();
+            if (!frames.empty()) {
+                uint32_t parent = frames.back().node;
+                low[parent] = std::min(low[parent], low[node]);
+            }
+            if (low[node] != index[node]) continue;
+            uint32_t component = static_cast<uint32_t>(component_start_.size() - 1);
+            uint32_t member;
+            do {
+                member = stack.back();
+                stack.pop_back();
+                on_stack[member] = false;
+                component_[member] = component;
+                position_[member] = static_cast<uint32_t>(members_.size());
+                members_.push_back(member);
+            } while (member != node);
+            component_start_.push_back(static_cast<uint32_t>(members_.size()));
+        }
+    }
+
+    size_t components = component_start_.size() - 1;
+    std::vector<uint32_t> level(components, 0);
+    uint32_t top = 0;
+    for (uint32_t component = 0; component < components; component++) {
+        for (uint32_t i = component_start_[component]; i < component_start_[component + 1]; i++) {
+            uint32_t node = members_[i];
+            for (uint32_t edge = edge_start_[node]; edge < edge_start_[node + 1]; edge++) {
+                uint32_t callee = component_[targets_[edge]];
+                if (callee != component) level[component] = std::max(level[component], level[callee] + 1);
+            }
+        }
+        top = std::max(top, level[component]);
+    }
+    // Counting sort of the components by level.
+    level_start_.assign(components ? top + 2 : 1, 0);
+    for (uint32_t l : level) level_start_[l + 1]++;
+    for (size_t l = 1; l < level_start_.size(); l++) level_start_[l] += level_start_[l - 1];
+    by_level_.resize(components);
+    std::vector<uint32_t> fill(level_start_.begin(), level_start_.end() - 1);
+    for (uint32_t component = 0; component < components; component++) by_level_[fill[level[component]]++] = component;
+}
+
+// What `node` returns, given the values of everything it forwards to.
+ConstantValue CallGraph::resolve_node(uint32_t node) const {
+    const ReturnSummary &summary = *nodes_[node].summary;
+    if (!summary.returns) return ConstantValue();
+    if (summary.constant.status != ConstantValue::Unknown || forward_[node] == none) {
+        return returned_constant(summary.constant, summary.type);
+    }
+    // Overloads are not told apart, so they must all agree.
+    ConstantValue value = values_[forward_[node]];
+    for (uint32_t target = next_[forward_[node]]; target != none; target = next_[target]) {
+        const ConstantValue &other = values_[target];
+        if (other.status != value.status || !(other.type == value.type) || other.bits != value.bits) return ConstantValue();
+    }
+    return returned_constant(value, summary.type);
+}
+
+// Everything the members call outside the component is resolved already.
+// Inside it, a member is resolved once every member it forwards to is; the
+// ones left waiting forward around a cycle and stay Unknown.
+void CallGraph::resolve_component(uint32_t component) {
+    uint32_t begin = component_start_[component];
+    uint32_t size = component_start_[component + 1] - begin;
+    if (size == 1) {
+        values_[members_[begin]] = resolve_node(members_[begin]);
+        return;
+    }
+    // waits holds (member forwarded to, forwarding member) pairs; grouped by
+    // the first with a counting sort.
+    std::vector<uint32_t> pending(size, 0);
+    std::vector<std::pair<uint32_t, uint32_t>> waits;
+    for (uint32_t i = 0; i < size; i++) {
+        uint32_t node = members_[begin + i];
+        const ReturnSummary &summary = *nodes_[node].summary;
+        if (!summary.returns || summary.constant.status != ConstantValue::Unknown) continue;
+        for (uint32_t target = forward_[node]; target != none; target = next_[target]) {
+            if (component_[target] != component) continue;
+            pending[i]++;
+            waits.push_back({position_[target] - begin, i});
+        }
+    }
+    std::vector<uint32_t> waiter_start(size + 1, 0);
+    for (const auto &wait : waits) waiter_start[wait.first + 1]++;
+    for (uint32_t i = 0; i < size; i++) waiter_start[i + 1] += waiter_start[i];
+    std::vector<uint32_t> waiters(waits.size());
+    std::vector<uint32_t> fill(waiter_start.begin(), waiter_start.end() - 1);
+    for (const auto &wait : waits) waiters[fill[wait.first]++] = wait.second;
+
+    std::vector<uint32_t> ready;
+    for (uint32_t i = 0; i < size; i++) {
+        if (pending[i] == 0) ready.push_back(i);
+    }
+    while (!ready.empty()) {
+        uint32_t i = ready.back();
+        ready.pop_back();
+        values_[members_[begin + i]] = resolve_node(members_[begin + i]);
+        for (uint32_t w = waiter_start[i]; w < waiter_start[i + 1]; w++) {
+            if (--pending[waiters[w]] == 0) ready.push_back(waiters[w]);
+        }
+    }
+}
+
+void CallGraph::solve(unsigned jobs) {
+    if (!dirty_) return;
+    link(jobs);
+    order();
+    values_.assign(nodes_.size(), ConstantValue());
+    // A level only calls into lower ones, so its components are independent.
+    for (size_t l = 0; l + 1 < level_start_.size(); l++) {
+        size_t count = level_start_[l + 1] - level_start_[l];
+        const uint32_t *components = by_level_.data() + level_start_[l];
+        parallel_for(count, count < parallel_threshold ? 1 : jobs,
+                     [&](size_t i, unsigned) { resolve_component(components[i]); });
+    }
+
+    results_.clear();
+    results_.reserve(nodes_.size());
+    for (size_t i = 0; i < nodes_.size(); i++) {
+        const ReturnSummary &summary = *nodes_[i].summary;
+        results_.push_back({summary.name, *nodes_[i].path, summary.value, summary.returns, values_[i]});
+    }
+    std::stable_sort(results_.begin(), results_.end(),
+                     [](const ResolvedReturn &a, const ResolvedReturn &b) { return a.name < b.name; });
+    dirty_ = false;
+}
+
+void print_resolved_returns(const std::vector<ResolvedReturn> &results, std::ostream &out) {
+    out << "-------------------------------------------------------------\n";
+    out << std::left << std::setw(40) << "Function" << std::setw(22) << "Resolved" << "Return Value" << "\n";
+    out << "-------------------------------------------------------------\n";
+    for (const ResolvedReturn &result : results) {
+        std::string resolved = result.constant.status == ConstantValue::Overflow ? "overflow" : constant_text(result.constant);
+        out << std::left << std::setw(40) << result.name << std::setw(22) << (resolved.empty() ? "?" : resolved)
+            << (result.returns ? result.value : "-") << "\n";
+    }
+    out << "-------------------------------------------------------------\n";
+}
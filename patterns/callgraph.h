@@ -0,0 +1,91 @@
+#pragma once
+#include "common.h"
+#include "returnv.h"
+#include <map>
+#include <unordered_map>
+
+// A function's return value once calls into other functions are followed.
+struct ResolvedReturn {
+    std::string name;
+    std::string path;       // file the definition is in
+    std::string value;      // the summary's returned expression
+    bool returns;           // a return statement was reached
+    ConstantValue constant; // in the declared return type
+};
+
+// Converts a value a function returns to its declared return `type` (as in
+// ReturnSummary::type). `auto` keeps the value; types cast_constant does not
+// know make it Unknown.
+ConstantValue returned_constant(const ConstantValue &value, std::string_view type);
+
+// Call graph over the return summaries of every file of a project, with
+// return values propagated bottom-up: a function whose first return is a bare
+// call (`return helper();`) returns whatever all functions of that name
+// return, converted to its own return type.
+//
+// Callees are resolved by name from the caller's scope outwards (`g` called
+// from `ns::A::f` is `ns::A::g`, then `ns::g`, then `g`), each to every
+// overload. Strongly connected components are found with an iterative
+// Tarjan walk and solved callees first; components with no path between them
+// are solved in parallel, one level of the condensation at a time. Inside a
+// component a forwarder waits for the members it forwards to; forwarding
+// around a cycle never returns and stays Unknown.
+//
+// solve() is linear in functions plus calls, so keeping the graph current
+// after an edit costs reanalyzing that one file (set_file with its new
+// summaries, which a session or the result cache provide) and relinking.
+class CallGraph {
+public:
+    // Replaces the functions defined in `path`.
+    void set_file(const std::string &path, std::vector<ReturnSummary> summaries);
+    void remove_file(const std::string &path);
+
+    // Links, orders and resolves everything; a no-op when no file changed.
+    void solve(unsigned jobs = 0);
+
+    // Every function, sorted by name (overloads in path and source order).
+    const std::vector<ResolvedReturn> &results() const { return results_; }
+    // First function named `name` in results(), or null.
+    const ResolvedReturn *find(std::string_view name) const;
+
+    size_t functions() const { return nodes_.size(); }
+    size_t edges() const { return targets_.size(); }
+    size_t components() const { return component_start_.empty() ? 0 : component_start_.size() - 1; }
+    size_t levels() const { return level_start_.empty() ? 0 : level_start_.size() - 1; }
+
+private:
+    static constexpr uint32_t none = UINT32_MAX;
+
+    struct Node {
+        const ReturnSummary *summary;
+        const std::string *path;
+    };
+
+    uint32_t lookup(std::string_view caller, std::string_view callee) const;
+    void link(unsigned jobs);
+    void order();
+    void resolve_component(uint32_t component);
+    ConstantValue resolve_node(uint32_t node) const;
+
+    std::map<std::string, std::vector<ReturnSummary>> files_;
+    bool dirty_ = false;
+
+    // Rebuilt by solve; nodes point into files_.
+    std::vector<Node> nodes_;
+    std::unordered_map<std::string_view, uint32_t> first_; // first node of each name
+    std::vector<uint32_t> next_;                          // next node of the same name
+    std::vector<uint32_t> forward_;                       // first node `forward` names, or none
+    std::vector<uint32_t> edge_start_;                    // calls of node i: targets_[edge_start_[i], edge_start_[i + 1])
+    std::vector<uint32_t> targets_;
+    std::vector<uint32_t> component_;                     // of each node
+    std::vector<uint32_t> position_;                      // of each node in members_
+    std::vector<uint32_t> component_start_;               // members of component c: members_[component_start_[c], ...)
+    std::vector<uint32_t> members_;                       // components in bottom-up order
+    std::vector<uint32_t> level_start_;                   // components of level l: by_level_[level_start_[l], ...)
+    std::vector<uint32_t> by_level_;
+    std::vector<ConstantValue> values_;
+    std::vector<ResolvedReturn> results_;
+};
+
+// Writes `results` as a name / resolved value / returned expression table.
+void print_resolved_returns(const std::vector<ResolvedReturn> &results, std::ostream &out = std::cout);
@@ -0,0 +1,159 @@
+#include "checker.h"
+#include "instrument.h"
+#include "budget.h"
+
+static const uint32_t not_muted = UINT32_MAX;
+
+void CheckerPipeline::add(Checker &checker) {
+    slots_.push_back({&checker, not_muted, false});
+    subscriptions_.push_back(checker.subscriptions(cpp_grammar()));
+    indexed_ = false;
+}
+
+void CheckerPipeline::index_subscriptions() {
+    uint32_t symbol_count = cpp_grammar().symbol_count;
+    offsets_.assign(symbol_count + 1, 0);
+    for (const std::vector<TSSymbol> &symbols : subscriptions_) {
+        for (TSSymbol symbol : symbols) {
+            if (symbol != 0 && symbol < symbol_count) offsets_[symbol + 1]++;
+        }
+    }
+    for (uint32_t s = 0; s < symbol_count; s++) offsets_[s + 1] += offsets_[s];
+
+    subscribers_.assign(offsets_[symbol_count], 0);
+    std::vector<uint32_t> fill(offsets_.begin(), offsets_.end() - 1);
+    for (uint32_t c = 0; c < subscriptions_.size(); c++) {
+        for (TSSymbol symbol : subscriptions_[c]) {
+            if (symbol != 0 && symbol < symbol_count) subscribers_[fill[symbol]++] = c;
+        }
+    }
+    index_queries();
+    indexed_ = true;
+}
+
+void CheckerPipeline::index_queries() {
+    // Patterns keep their order when sources are concatenated, so each
+    // checker's patterns form one contiguous block of the combined query.
+    std::string combined;
+    query_slots_.clear();
+    pattern_owners_.clear();
+    for (uint32_t c = 0; c < slots_.size(); c++) {
+        std::string_view source = slots_[c].checker->query();
+        if (source.empty()) continue;
+        const Query &own = shared_query(source);
+        query_slots_.push_back({c, static_cast<uint32_t>(pattern_owners_.size()), {}});
+        pattern_owners_.insert(pattern_owners_.end(), own.pattern_count(),
+                               static_cast<uint32_t>(query_slots_.size() - 1));
+        combined.append(source).append("\n");
+    }
+    query_ = combined.empty() ? nullptr : &shared_query(combined);
+    if (!query_) return;
+
+    // Capture names are shared between checkers in the combined query; map
+    // them back to each checker's own ids.
+    for (QuerySlot &query_slot : query_slots_) {
+        const Query &own = shared_query(slots_[query_slot.slot].checker->query());
+        query_slot.captures.resize(query_->capture_count());
+        for (uint32_t id = 0; id < query_->capture_count(); id++) {
+            query_slot.captures[id] = own.capture_id(query_->capture_name(id));
+        }
+    }
+}
+
+void CheckerPipeline::run_queries(TSNode root, uint32_t start_byte, uint32_t end_byte, uint64_t &check_nanos) {
+    Metrics *metrics = current_metrics();
+    size_t active = query_slots_.size();
+    cursor_.exec(*query_, root, start_byte, end_byte);
+    TSQueryMatch found;
+    while (active && cursor_.next(found)) {
+        const QuerySlot &owner = query_slots_[pattern_owners_[found.pattern_index]];
+        Slot &slot = slots_[owner.slot];
+        if (slot.stopped) continue;
+        captures_.assign(found.captures, found.captures + found.capture_count);
+        for (TSQueryCapture &capture : captures_) capture.index = owner.captures[capture.index];
+        QueryMatch match{found.pattern_index - owner.first_pattern, captures_.data(), found.capture_count};
+
+        uint64_t start = metrics ? monotonic_nanos() : 0;
+        Visit visit = slot.checker->match(match);
+        if (metrics) check_nanos += monotonic_nanos() - start;
+        if (visit == Visit::Stop) {
+            slot.stopped = true;
+            active--;
+        }
+    }
+}
+
+void CheckerPipeline::run(TSNode root, std::string_view code, uint32_t start_byte, uint32_t end_byte) {
+    if (!indexed_) index_subscriptions();
+    // With instrumentation on, time spent inside checkers is booked as the
+    // check phase and the rest of the walk as the walk phase.
+    Metrics *metrics = current_metrics();
+    uint64_t walk_start = metrics ? monotonic_nanos() : 0;
+    uint64_t check_nanos = 0;
+    uint64_t nodes = 0;
+    auto timed = [&](auto &&callback) {
+        if (!metrics) return callback();
+        uint64_t start = monotonic_nanos();
+        auto visit = callback();
+        check_nanos += monotonic_nanos() - start;
+        return visit;
+    };
+
+    for (Slot &slot : slots_) {
+        slot.muted_depth = not_muted;
+        slot.stopped = false;
+        timed([&] { slot.checker->begin(code); return 0; });
+    }
+
+    if (query_) run_queries(root, start_byte, end_byte, check_nanos);
+
+    // Query-only checkers have no node subscriptions; skip the walk entirely
+    // when nobody else needs it.
+    uint32_t symbol_count = static_cast<uint32_t>(offsets_.size() - 1);
+    size_t active = 0;
+    for (uint32_t c = 0; c < slots_.size(); c++) {
+        if (!slots_[c].stopped && !subscriptions_[c].empty()) active++;
+    }
+    bool ranged = start_byte > 0 || end_byte < UINT32_MAX;
+    auto outside = [&](TSNode node) {
+        return ranged && (ts_node_end_byte(node) <= start_byte || ts_node_start_byte(node) >= end_byte);
+    };
+    if (active) walker_.walk(root, [&](TSNode node, uint32_t depth) {
+        if (depth > 0 && outside(node)) return Visit::SkipChildren;
+        if ((++nodes & 1023) == 0 && budget_expired()) return Visit::Stop;
+        TSSymbol symbol = ts_node_symbol(node);
+        if (symbol >= symbol_count) return Visit::Continue;
+        for (uint32_t i = offsets_[symbol]; i < offsets_[symbol + 1]; i++) {
+            Slot &slot = slots_[subscribers_[i]];
+            if (slot.stopped || (slot.muted_depth != not_muted && depth > slot.muted_depth)) continue;
+            Visit visit = timed([&] { return slot.checker->enter(node, depth); });
+            if (visit == Visit::SkipChildren) {
+                slot.muted_depth = depth;
+            } else if (visit == Visit::Stop) {
+                slot.stopped = true;
+                active--;
+            }
+        }
+        return active ? Visit::Continue : Visit::Stop;
+    }, [&](TSNode node, uint32_t depth) {
+        if (depth > 0 && outside(node)) return;
+        TSSymbol symbol = ts_node_symbol(node);
+        if (symbol >= symbol_count) return;
+        for (uint32_t i = offsets_[symbol]; i < offsets_[symbol + 1]; i++) {
+            Slot &slot = slots_[subscribers_[i]];
+            if (slot.stopped || (slot.muted_depth != not_muted && depth > slot.muted_depth)) continue;
+            timed([&] { slot.checker->leave(node, depth); return 0; });
+            if (slot.muted_depth == depth) slot.muted_depth = not_muted;
+        }
+    });
+
+    for (Slot &slot : slots_) {
+        timed([&] { slot.checker->finish(); return 0; });
+    }
+
+    if (metrics) {
+        metrics->nodes += nodes;
+        metrics->nanos[phase_check] += check_nanos;
+        metrics->nanos[phase_walk] += monotonic_nanos() - walk_start - check_nanos;
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include "common.h"
+#include "grammar.h"
+#include "query.h"
+#include "visitor.h"
+
+// A checker is one analysis that reacts to a fixed set of node kinds, to the
+// matches of a tree-sitter query, or both. Checkers do not walk the tree
+// themselves: a CheckerPipeline walks it once and hands each node to the
+// checkers subscribed to its kind, and runs all checkers' queries as one
+// combined query, so adding a checker costs its callbacks, not another parse
+// and traversal.
+class Checker {
+public:
+    virtual ~Checker() = default;
+
+    // Node kinds this checker wants to see. Queried once, when the checker is
+    // added to a pipeline.
+    virtual std::vector<TSSymbol> subscriptions(const CppGrammar &g) const = 0;
+
+    // Query patterns (S-expressions) whose matches go to match(). Must return
+    // the same text every time; it is compiled once per process.
+    virtual std::string_view query() const { return {}; }
+
+    // Called before the walk with the source the tree was parsed from. The
+    // buffer stays valid until finish() returns.
+    virtual void begin(std::string_view code) { (void)code; }
+
+    // Pre-order callback for a subscribed node. SkipChildren hides the node's
+    // subtree from this checker only; Stop ends this checker's part of the walk.
+    virtual Visit enter(TSNode node, uint32_t depth) { (void)node; (void)depth; return Visit::Continue; }
+
+    // Post-order callback for a subscribed node the checker entered.
+    virtual void leave(TSNode node, uint32_t depth) { (void)node; (void)depth; }
+
+    // One match of query(), in the order the query cursor reports them (the
+    // order matches complete; disjoint matches come in source order). Matches
+    // arrive before any node callback. Stop ends this checker's part of the run.
+    virtual Visit match(const QueryMatch &match) { (void)match; return Visit::Continue; }
+
+    // Called after the walk, including for checkers that stopped early.
+    virtual void finish() {}
+};
+
+// Runs any number of checkers in one fused traversal. Subscriptions are kept
+// as a symbol-indexed table (offsets into one flat list of checker indices),
+// so a node nobody subscribed to costs a single lookup. The checkers' queries
+// are concatenated into one query, so they share a single cursor pass, and
+// each match is routed back to its checker by pattern index.
+class CheckerPipeline {
+public:
+    // The pipeline does not own the checker; it must outlive run().
+    void add(Checker &checker);
+
+    // Walks `root` once, dispatching to every added checker. With a byte
+    // range, only query matches and nodes intersecting [start_byte, end_byte)
+    // are delivered, and the query cursor and walk skip everything else.
+    void run(TSNode root, std::string_view code, uint32_t start_byte = 0, uint32_t end_byte = UINT32_MAX);
+
+private:
+    struct Slot {
+        Checker *checker;
+        uint32_t muted_depth; // subtree hidden below this depth; none when not muted
+        bool stopped;
+    };
+
+    // A checker with a query: its patterns start at `first_pattern` in the
+    // combined query, and `captures` maps combined capture ids to its own.
+    struct QuerySlot {
+        uint32_t slot;
+        uint32_t first_pattern;
+        std::vector<uint32_t> captures;
+    };
+
+    void index_subscriptions();
+    void index_queries();
+    void run_queries(TSNode root, uint32_t start_byte, uint32_t end_byte, uint64_t &check_nanos);
+
+    std::vector<Slot> slots_;
+    std::vector<std::vector<TSSymbol>> subscriptions_;
+    std::vector<uint32_t> offsets_; // per symbol: range into subscribers_
+    std::vector<uint32_t> subscribers_;
+    bool indexed_ = false;
+    TreeWalker walker_;
+
+    const Query *query_ = nullptr; // all checkers' patterns; null when none has a query
+    std::vector<QuerySlot> query_slots_;
+    std::vector<uint32_t> pattern_owners_; // combined pattern index -> query_slots_ index
+    std::vector<TSQueryCapture> captures_;
+    QueryCursor cursor_;
+};
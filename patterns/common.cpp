@@ -1,6 +1,14 @@
 #include "common.h"
-std::string ts_node_string(TSNode node, const std::string& code){
-    size_t start_byte = ts_node_start_byte(node);
-    size_t end_byte = ts_node_end_byte(node);
-    return code.substr(start_byte, end_byte - start_byte);
-}
\ No newline at end of file
+#include <charconv>
+
+std::string ts_node_string(TSNode node, std::string_view code){
+    return std::string(node_text(node, code));
+}
+
+bool parse_unsigned(std::string_view text, uint64_t max, uint64_t &out) {
+    uint64_t value = 0;
+    auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (text.empty() || error != std::errc() || end != text.data() + text.size() || value > max) return false;
+    out = value;
+    return true;
+}
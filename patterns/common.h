@@ -6,6 +6,23 @@
 #include <vector>
 #include <set>
 #include <algorithm>
+#include <string>
+#include <string_view>
 #include <string.h>
 extern "C" const TSLanguage *tree_sitter_cpp();
-std::string ts_node_string(TSNode, const std::string&);
\ No newline at end of file
+
+// Text of `node` as a view into `source`, the buffer the tree was parsed from.
+// Nothing is copied, so the view is valid exactly as long as `source` is:
+// analyses borrow the caller's buffer for the duration of a run and copy text
+// only when they store it in a result.
+inline std::string_view node_text(TSNode node, std::string_view source) {
+    uint32_t start = ts_node_start_byte(node);
+    return source.substr(start, ts_node_end_byte(node) - start);
+}
+
+// Owning copy of node_text(), for text that must outlive the source buffer.
+std::string ts_node_string(TSNode, std::string_view);
+
+// Parses all of `text` as a decimal number no greater than `max`. Unlike
+// std::stoull, a sign, trailing characters or an out-of-range value fail.
+bool parse_unsigned(std::string_view text, uint64_t max, uint64_t &out);
@@ -1,44 +1,537 @@
-#include "common.h"
-int evaluate_expression(TSNode node, const std::string &code, const std::unordered_map<std::string, int>& variables) {
-    std::string type = ts_node_type(node);
-    if (type == "number_literal") {
-        uint32_t start = ts_node_start_byte(node);
-        uint32_t end = ts_node_end_byte(node);
-        std::string text = code.substr(start, end - start);
-        return std::atoi(text.c_str());
-    }
-    if (type == "identifier") {
-        uint32_t start = ts_node_start_byte(node);
-        uint32_t end = ts_node_end_byte(node);
-        std::string ident = code.substr(start, end - start);
-        auto it = variables.find(ident);
-        return (it != variables.end()) ? it->second : 0;
-    }
-    if (type == "binary_expression") {
-        if (ts_node_child_count(node) < 3) return 0;
-        TSNode left  = ts_node_child(node, 0);
-        TSNode opNode = ts_node_child(node, 1);
-        TSNode right = ts_node_child(node, 2);
-        int leftVal = evaluate_expression(left, code, variables);
-        int rightVal = evaluate_expression(right, code, variables);
-        uint32_t opStart = ts_node_start_byte(opNode);
-        uint32_t opEnd = ts_node_end_byte(opNode);
-        std::string op = code.substr(opStart, opEnd - opStart);
-        if (op == "+") return leftVal + rightVal;
-        if (op == "-") return leftVal - rightVal;
-        if (op == "*") return leftVal * rightVal;
-        if (op == "/") return (rightVal != 0) ? leftVal / rightVal : 0;
-    }
-    if (type == "parenthesized_expression") {
-        // Assume the inner expression is the second child.
-        TSNode inner = ts_node_child(node, 1);
-        return evaluate_expression(inner, code, variables);
-    }
-    return 0;
-}
-
-// Determines if the given condition evaluates to a non-zero value.
-bool is_constant_true(TSNode condition, const std::string &code, const std::unordered_map<std::string, int>& variables) {
-    int value = evaluate_expression(condition, code, variables);
-    return value != 0;
-}
\ No newline at end of file
+#include "constant_evaluator.h"
+#include "grammar.h"
+#include "propagation.h"
+#include <cctype>
+
+static const ConstantType size_type{64, true};
+
+ConstantValue ConstantValue::of(uint64_t value, ConstantType type) {
+    if (type.bits == 32) {
+        uint32_t low = static_cast<uint32_t>(value);
+        value = type.is_unsigned ? low : static_cast<uint64_t>(static_cast<int64_t>(static_cast<int32_t>(low)));
+    }
+    return {Known, type, value};
+}
+
+ConstantValue convert_constant(const ConstantValue &value, ConstantType type) {
+    return value.known() ? ConstantValue::of(value.bits, type) : value;
+}
+
+// Smallest and largest value of a signed type.
+static int64_t signed_min(ConstantType type) { return type.bits == 32 ? INT32_MIN : INT64_MIN; }
+static int64_t signed_max(ConstantType type) { return type.bits == 32 ? INT32_MAX : INT64_MAX; }
+
+static bool fits(uint64_t value, ConstantType type) {
+    uint64_t max = type.is_unsigned ? (type.bits == 32 ? UINT32_MAX : UINT64_MAX)
+                                    : static_cast<uint64_t>(signed_max(type));
+    return value <= max;
+}
+
+// The result of a signed operation, or Overflow when it leaves the type's range.
+static ConstantValue checked(bool overflowed, int64_t value, ConstantType type) {
+    if (overflowed || value < signed_min(type) || value > signed_max(type)) return ConstantValue::overflow();
+    return ConstantValue::of(static_cast<uint64_t>(value), type);
+}
+
+// a * b on int64_t without relying on compiler builtins (MSVC has none for this).
+static bool multiply_overflows(int64_t a, int64_t b, int64_t &product) {
+    product = 0;
+    if (a == 0 || b == 0) return false;
+    bool negative = (a < 0) != (b < 0);
+    uint64_t magnitude_a = a < 0 ? 0 - static_cast<uint64_t>(a) : static_cast<uint64_t>(a);
+    uint64_t magnitude_b = b < 0 ? 0 - static_cast<uint64_t>(b) : static_cast<uint64_t>(b);
+    uint64_t limit = negative ? static_cast<uint64_t>(INT64_MAX) + 1 : static_cast<uint64_t>(INT64_MAX);
+    if (magnitude_a > limit / magnitude_b) return true;
+    uint64_t magnitude = magnitude_a * magnitude_b;
+    product = negative ? static_cast<int64_t>(0 - magnitude) : static_cast<int64_t>(magnitude);
+    return false;
+}
+
+// The type both operands of an arithmetic operator are converted to. Only
+// int-sized and 64-bit types remain after promotion, and a signed 64-bit
+// type holds every unsigned 32-bit value.
+static ConstantType common_type(ConstantType a, ConstantType b) {
+    if (a.bits != b.bits) return a.bits > b.bits ? a : b;
+    return {a.bits, a.is_unsigned || b.is_unsigned};
+}
+
+static ConstantValue logical(std::string_view op, const ConstantValue &left, const ConstantValue &right) {
+    bool is_and = op == "&&";
+    // The operand value that settles the result on its own.
+    auto decides = [&](const ConstantValue &value) { return is_and ? value.is_false() : value.is_true(); };
+    if (decides(left)) return ConstantValue::of(is_and ? 0 : 1);
+    if (left.status == ConstantValue::Overflow) return left;
+    if (left.known()) return right.known() ? ConstantValue::of(right.bits != 0) : right;
+    if (decides(right)) return ConstantValue::of(is_and ? 0 : 1);
+    return ConstantValue();
+}
+
+static ConstantValue shift(std::string_view op, const ConstantValue &left, const ConstantValue &right) {
+    ConstantType type = left.type;
+    bool negative_count = !right.type.is_unsigned && right.as_signed() < 0;
+    if (negative_count || right.bits >= type.bits) return ConstantValue::overflow();
+    unsigned count = static_cast<unsigned>(right.bits);
+    // C++20 semantics: << wraps modulo 2^bits, >> of a negative value is arithmetic.
+    if (op == "<<") return ConstantValue::of(left.bits << count, type);
+    if (type.is_unsigned) return ConstantValue::of(left.bits >> count, type);
+    int64_t value = left.as_signed();
+    return ConstantValue::of(static_cast<uint64_t>(value < 0 ? ~(~value >> count) : value >> count), type);
+}
+
+static ConstantValue compare(std::string_view op, ConstantValue left, ConstantValue right) {
+    ConstantType type = common_type(left.type, right.type);
+    left = convert_constant(left, type);
+    right = convert_constant(right, type);
+    bool less = type.is_unsigned ? left.bits < right.bits : left.as_signed() < right.as_signed();
+    bool greater = type.is_unsigned ? left.bits > right.bits : left.as_signed() > right.as_signed();
+    bool result = false;
+    if (op == "==") result = !less && !greater;
+    else if (op == "!=") result = less || greater;
+    else if (op == "<") result = less;
+    else if (op == ">") result = greater;
+    else if (op == "<=") result = !greater;
+    else if (op == ">=") result = !less;
+    return ConstantValue::of(result);
+}
+
+static ConstantValue arithmetic(std::string_view op, ConstantValue left, ConstantValue right) {
+    ConstantType type = common_type(left.type, right.type);
+    left = convert_constant(left, type);
+    right = convert_constant(right, type);
+    if (op == "&") return ConstantValue::of(left.bits & right.bits, type);
+    if (op == "|") return ConstantValue::of(left.bits | right.bits, type);
+    if (op == "^") return ConstantValue::of(left.bits ^ right.bits, type);
+    if ((op == "/" || op == "%") && right.bits == 0) return ConstantValue::overflow();
+
+    if (type.is_unsigned) {
+        uint64_t a = left.bits, b = right.bits;
+        if (op == "+") return ConstantValue::of(a + b, type);
+        if (op == "-") return ConstantValue::of(a - b, type);
+        if (op == "*") return ConstantValue::of(a * b, type);
+        if (op == "/") return ConstantValue::of(a / b, type);
+        if (op == "%") return ConstantValue::of(a % b, type);
+        return ConstantValue();
+    }
+
+    int64_t a = left.as_signed(), b = right.as_signed();
+    int64_t min = signed_min(type), max = signed_max(type);
+    // 32-bit operands cannot overflow int64_t, so checked() alone catches them.
+    if (op == "+") return checked((b > 0 && a > max - b) || (b < 0 && a < min - b), a + b, type);
+    if (op == "-") return checked((b < 0 && a > max + b) || (b > 0 && a < min + b), a - b, type);
+    if (op == "*") {
+        int64_t product;
+        bool overflowed = multiply_overflows(a, b, product);
+        return checked(overflowed, product, type);
+    }
+    if (op != "/" && op != "%") return ConstantValue();
+    if (a == min && b == -1) return ConstantValue::overflow();
+    return ConstantValue::of(static_cast<uint64_t>(op == "/" ? a / b : a % b), type);
+}
+
+ConstantValue fold_binary(std::string_view op, const ConstantValue &left, const ConstantValue &right) {
+    if (op == "&&" || op == "and") return logical("&&", left, right);
+    if (op == "||" || op == "or") return logical("||", left, right);
+    if (left.status == ConstantValue::Overflow || right.status == ConstantValue::Overflow) return ConstantValue::overflow();
+    if (!left.known() || !right.known()) return ConstantValue();
+    if (op == "<<" || op == ">>") return shift(op, left, right);
+    if (op == "==" || op == "!=" || op == "<" || op == ">" || op == "<=" || op == ">=") return compare(op, left, right);
+    if (op == "bitand") return arithmetic("&", left, right);
+    if (op == "bitor") return arithmetic("|", left, right);
+    if (op == "xor") return arithmetic("^", left, right);
+    if (op == "not_eq") return compare("!=", left, right);
+    return arithmetic(op, left, right);
+}
+
+ConstantValue fold_unary(std::string_view op, const ConstantValue &operand) {
+    if (!operand.known()) return operand;
+    ConstantType type = operand.type;
+    if (op == "!" || op == "not") return ConstantValue::of(operand.bits == 0);
+    if (op == "~" || op == "compl") return ConstantValue::of(~operand.bits, type);
+    if (op == "+") return operand;
+    if (op == "-") {
+        if (type.is_unsigned) return ConstantValue::of(0 - operand.bits, type);
+        if (operand.as_signed() == signed_min(type)) return ConstantValue::overflow();
+        return ConstantValue::of(static_cast<uint64_t>(-operand.as_signed()), type);
+    }
+    return ConstantValue();
+}
+
+// Value of a character literal: a single character or escape sequence.
+// Multi-character literals are implementation-defined and stay Unknown.
+static ConstantValue parse_char_literal(std::string_view text) {
+    size_t quote = text.find('\'');
+    if (quote == std::string_view::npos || text.size() < quote + 3 || text.back() != '\'') return ConstantValue();
+    bool plain = quote == 0;
+    std::string_view body = text.substr(quote + 1, text.size() - quote - 2);
+    uint64_t value = 0;
+    size_t used = 1;
+    if (body[0] != '\\') {
+        value = static_cast<unsigned char>(body[0]);
+    } else if (body.size() < 2) {
+        return ConstantValue();
+    } else {
+        char escape = body[1];
+        used = 2;
+        switch (escape) {
+        case 'n': value = '\n'; break;
+        case 't': value = '\t'; break;
+        case 'r': value = '\r'; break;
+        case 'a': value = '\a'; break;
+        case 'b': value = '\b'; break;
+        case 'f': value = '\f'; break;
+        case 'v': value = '\v'; break;
+        case '\\': case '\'': case '"': case '?': value = static_cast<unsigned char>(escape); break;
+        case 'x':
+            while (used < body.size() && isxdigit(static_cast<unsigned char>(body[used]))) {
+                char digit = body[used++];
+                value = value * 16 + (isdigit(static_cast<unsigned char>(digit)) ? digit - '0' : (digit | 0x20) - 'a' + 10);
+            }
+            if (used == 2) return ConstantValue();
+            break;
+        default:
+            if (escape < '0' || escape > '7') return ConstantValue();
+            used = 1;
+            while (used < body.size() && used < 4 && body[used] >= '0' && body[used] <= '7') {
+                value = value * 8 + (body[used++] - '0');
+            }
+        }
+    }
+    if (used != body.size()) return ConstantValue();
+    // A plain char is taken to be signed and promotes to int; prefixed
+    // literals (L, u, U, u8) keep their code unit value.
+    if (plain) return ConstantValue::of(static_cast<uint64_t>(static_cast<int64_t>(static_cast<signed char>(value))));
+    return ConstantValue::of(value);
+}
+
+ConstantValue parse_integer_literal(std::string_view text) {
+    if (text == "true") return ConstantValue::of(1);
+    if (text == "false") return ConstantValue::of(0);
+    if (text.empty()) return ConstantValue();
+    if (text.back() == '\'') return parse_char_literal(text);
+
+    unsigned base = 10;
+    size_t i = 0;
+    if (text.size() > 1 && text[0] == '0') {
+        char prefix = static_cast<char>(text[1] | 0x20);
+        if (prefix == 'x') base = 16, i = 2;
+        else if (prefix == 'b') base = 2, i = 2;
+        else base = 8, i = 1;
+    }
+
+    uint64_t value = 0;
+    bool overflowed = false;
+    size_t digits = 0;
+    for (; i < text.size(); i++) {
+        char c = text[i];
+        if (c == '\'') continue;
+        unsigned digit;
+        if (c >= '0' && c <= '9') digit = c - '0';
+        else if (base == 16 && (c | 0x20) >= 'a' && (c | 0x20) <= 'f') digit = (c | 0x20) - 'a' + 10;
+        else break;
+        if (digit >= base) {
+            // 08 or 1e5 style: a decimal digit past an octal base, or a float.
+            if (base == 8 && digit < 10) return ConstantValue();
+            break;
+        }
+        if (value > (UINT64_MAX - digit) / base) overflowed = true;
+        value = value * base + digit;
+        digits++;
+    }
+    if (digits == 0 && base != 8) return ConstantValue();
+
+    // Suffix: u and one of l, ll or z in either order; anything else (a
+    // float's '.', an exponent, a user-defined suffix) is not an integer.
+    bool is_unsigned = false;
+    int longs = 0;
+    for (; i < text.size(); i++) {
+        char c = static_cast<char>(text[i] | 0x20);
+        if (c == 'u' && !is_unsigned) is_unsigned = true;
+        else if ((c == 'l' || c == 'z') && longs == 0) longs = 1;
+        else if (c == 'l' && longs == 1 && (text[i - 1] | 0x20) == 'l') longs = 2;
+        else return ConstantValue();
+    }
+    if (overflowed) return ConstantValue::overflow();
+
+    // The first type of the standard's list that holds the value; long is
+    // taken to be 64-bit (LP64). Decimal literals without u stay signed.
+    static const ConstantType candidates[] = {{32, false}, {32, true}, {64, false}, {64, true}};
+    for (const ConstantType &type : candidates) {
+        if (type.bits == 32 && longs) continue;
+        if (type.is_unsigned ? !is_unsigned && base == 10 : is_unsigned) continue;
+        if (fits(value, type)) return ConstantValue::of(value, type);
+    }
+    return ConstantValue::overflow();
+}
+
+// A type named in a cast or sizeof: its size in bytes and how an integral
+// value converts to it.
+struct NamedType {
+    uint8_t size;
+    bool integral;
+    bool is_unsigned;
+    bool is_bool;
+};
+
+// Recognizes primitive types (any order of signed/unsigned/short/long/int/
+// char, cv-qualifiers ignored), the fixed-width and size typedefs, and any
+// pointer. Sizes assume LP64.
+static bool named_type(std::string_view text, NamedType &type) {
+    if (text.find_first_of("*&") != std::string_view::npos) {
+        type = {8, false, true, false};
+        return true;
+    }
+    static const struct {
+        std::string_view name;
+        NamedType type;
+    } typedefs[] = {
+        {"int8_t", {1, true, false, false}},    {"uint8_t", {1, true, true, false}},
+        {"int16_t", {2, true, false, false}},   {"uint16_t", {2, true, true, false}},
+        {"int32_t", {4, true, false, false}},   {"uint32_t", {4, true, true, false}},
+        {"int64_t", {8, true, false, false}},   {"uint64_t", {8, true, true, false}},
+        {"size_t", {8, true, true, false}},     {"ssize_t", {8, true, false, false}},
+        {"ptrdiff_t", {8, true, false, false}}, {"intptr_t", {8, true, false, false}},
+        {"uintptr_t", {8, true, true, false}},  {"wchar_t", {4, true, false, false}},
+        {"char8_t", {1, true, true, false}},    {"char16_t", {2, true, true, false}},
+        {"char32_t", {4, true, true, false}},   {"float", {4, false, false, false}},
+        {"bool", {1, true, true, true}},
+    };
+    bool is_unsigned = false, is_signed = false, is_short = false, is_char = false;
+    int longs = 0;
+    bool is_double = false;
+    size_t words = 0;
+    const NamedType *alias = nullptr;
+    size_t i = 0;
+    while (i < text.size()) {
+        if (isspace(static_cast<unsigned char>(text[i]))) {
+            i++;
+            continue;
+        }
+        size_t end = i;
+        while (end < text.size() && !isspace(static_cast<unsigned char>(text[end]))) end++;
+        std::string_view word = text.substr(i, end - i);
+        i = end;
+        if (word.substr(0, 5) == "std::") word.remove_prefix(5);
+        if (word == "const" || word == "volatile") continue;
+        words++;
+        if (word == "unsigned") is_unsigned = true;
+        else if (word == "signed") is_signed = true;
+        else if (word == "short") is_short = true;
+        else if (word == "long") longs++;
+        else if (word == "char") is_char = true;
+        else if (word == "double") is_double = true;
+        else if (word != "int") {
+            alias = nullptr;
+            for (const auto &entry : typedefs) {
+                if (entry.name == word) alias = &entry.type;
+            }
+            if (!alias) return false;
+        }
+    }
+    if (alias) {
+        if (words != 1) return false;
+        type = *alias;
+        return true;
+    }
+    if (words == 0 || (is_unsigned && is_signed)) return false;
+    if (is_double) {
+        type = {static_cast<uint8_t>(longs ? 16 : 8), false, false, false};
+        return true;
+    }
+    uint8_t size = is_char ? 1 : is_short ? 2 : longs ? 8 : 4;
+    type = {size, true, is_unsigned, false};
+    return true;
+}
+
+// An integral conversion to a named type; values narrower than int are
+// truncated and promoted back to int.
+static ConstantValue cast(const ConstantValue &value, const NamedType &type) {
+    if (!value.known() || !type.integral) return value.status == ConstantValue::Overflow ? value : ConstantValue();
+    if (type.is_bool) return ConstantValue::of(value.bits != 0);
+    if (type.size < 4) {
+        unsigned bits = type.size * 8;
+        uint64_t low = value.bits & ((uint64_t(1) << bits) - 1);
+        bool negative = !type.is_unsigned && (low >> (bits - 1)) != 0;
+        return ConstantValue::of(negative ? low - (uint64_t(1) << bits) : low);
+    }
+    return ConstantValue::of(value.bits, {static_cast<uint8_t>(type.size * 8), type.is_unsigned});
+}
+
+ConstantValue cast_constant(const ConstantValue &value, std::string_view type) {
+    NamedType named;
+    return named_type(type, named) ? cast(value, named) : ConstantValue();
+}
+
+std::string constant_text(const ConstantValue &value) {
+    if (!value.known()) return std::string();
+    return value.type.is_unsigned ? std::to_string(value.bits) : std::to_string(value.as_signed());
+}
+
+void ConstantEvaluator::reset(std::string_view code) {
+    code_ = code;
+    memo_.clear();
+}
+
+void ConstantEvaluator::set_variable(std::string_view name, const ConstantValue &value) {
+    variables_[std::string(name)] = value;
+    memo_.clear();
+}
+
+void ConstantEvaluator::set_environment(const ConstantEnvironment *environment) {
+    environment_ = environment;
+    memo_.clear();
+}
+
+// Value of a node whose operands are not walked: literals, variables and
+// sizeof(type). Anything else is Unknown.
+ConstantValue ConstantEvaluator::leaf(TSNode node) const {
+    const CppGrammar &g = cpp_grammar();
+    TSSymbol type = ts_node_symbol(node);
+    if (type == g.number_literal || type == g.char_literal || type == g.true_literal || type == g.false_literal) {
+        return parse_integer_literal(node_text(node, code_));
+    }
+    if (type == g.identifier) {
+        std::string_view name = node_text(node, code_);
+        ConstantValue value;
+        if (environment_ && environment_->lookup(name, ts_node_start_byte(node), value)) return value;
+        if (variables_.empty()) return ConstantValue();
+        auto it = variables_.find(std::string(name));
+        return it != variables_.end() ? it->second : ConstantValue();
+    }
+    if (type == g.sizeof_expression) {
+        NamedType named;
+        TSNode descriptor = ts_node_child_by_field_id(node, g.field_type);
+        if (ts_node_is_null(descriptor) || !named_type(node_text(descriptor, code_), named)) return ConstantValue();
+        return ConstantValue::of(named.size, size_type);
+    }
+    return ConstantValue();
+}
+
+// Folds an operator node from the values of its value-carrying children.
+ConstantValue ConstantEvaluator::combine(TSNode node, const ConstantValue *operands, size_t count) const {
+    const CppGrammar &g = cpp_grammar();
+    TSSymbol type = ts_node_symbol(node);
+    auto op = [&] { return node_text(ts_node_child_by_field_id(node, g.field_operator), code_); };
+    if (type == g.binary_expression) {
+        return count == 2 ? fold_binary(op(), operands[0], operands[1]) : ConstantValue();
+    }
+    if (type == g.unary_expression) {
+        return count == 1 ? fold_unary(op(), operands[0]) : ConstantValue();
+    }
+    if (type == g.parenthesized_expression || type == g.condition_clause) {
+        return count == 1 ? operands[0] : ConstantValue();
+    }
+    if (type == g.conditional_expression) {
+        if (count != 3) return ConstantValue();
+        const ConstantValue &condition = operands[0], &consequence = operands[1], &alternative = operands[2];
+        if (condition.status == ConstantValue::Overflow) return condition;
+        // Only the selected branch is evaluated; its value takes the
+        // common type of both when the other one is known too.
+        ConstantType common = consequence.known() && alternative.known() ? common_type(consequence.type, alternative.type)
+                              : consequence.known()                      ? consequence.type
+                                                                         : alternative.type;
+        if (condition.is_true()) return convert_constant(consequence, common);
+        if (condition.is_false()) return convert_constant(alternative, common);
+        if (consequence.known() && alternative.known() &&
+            convert_constant(consequence, common).bits == convert_constant(alternative, common).bits) {
+            return convert_constant(consequence, common);
+        }
+        return ConstantValue();
+    }
+    if (type == g.cast_expression) {
+        TSNode descriptor = ts_node_child_by_field_id(node, g.field_type);
+        return count == 1 ? cast_constant(operands[0], node_text(descriptor, code_)) : ConstantValue();
+    }
+    if (type == g.sizeof_expression) {
+        // The operand is not evaluated, only its type matters, and a folded
+        // value only carries the promoted type. That is the operand's type
+        // for integer literals and arithmetic; comparisons, logical operators
+        // and `!` give bool, plain character literals char and casts the type
+        // cast to. Variables and anything else may be narrower: Unknown.
+        if (count != 1) return ConstantValue();
+        TSNode value = ts_node_child_by_field_id(node, g.field_value);
+        while (ts_node_symbol(value) == g.parenthesized_expression && ts_node_named_child_count(value) == 1) {
+            value = ts_node_named_child(value, 0);
+        }
+        TSSymbol kind = ts_node_symbol(value);
+        std::string_view op = node_text(ts_node_child_by_field_id(value, g.field_operator), code_);
+        if (kind == g.char_literal) {
+            // Prefixed ones (u'a', L'a') are char16_t and the like.
+            return node_text(value, code_).substr(0, 1) == "'" ? ConstantValue::of(1, size_type) : ConstantValue();
+        } else if (kind == g.cast_expression) {
+            NamedType named;
+            TSNode descriptor = ts_node_child_by_field_id(value, g.field_type);
+            if (named_type(node_text(descriptor, code_), named)) return ConstantValue::of(named.size, size_type);
+            return ConstantValue();
+        } else if (kind == g.binary_expression || kind == g.unary_expression) {
+            static const std::string_view boolean[] = {"==", "!=", "<", ">", "<=", ">=", "&&", "||", "!", "and", "or", "not", "not_eq"};
+            if (std::find(std::begin(boolean), std::end(boolean), op) != std::end(boolean)) return ConstantValue::of(1, size_type);
+        } else if (kind != g.number_literal) {
+            return ConstantValue();
+        }
+        return operands[0].known() ? ConstantValue::of(operands[0].type.bits / 8, size_type) : ConstantValue();
+    }
+    return ConstantValue();
+}
+
+// Folded bottom-up in the walker's post-order hook: leaves push their value,
+// and an operator node replaces its operands' values with its own once its
+// subtree is done. Operator tokens, parentheses, comments and the type of a
+// cast carry no value and push nothing.
+ConstantValue ConstantEvaluator::evaluate(TSNode node) {
+    if (ts_node_is_null(node)) return ConstantValue();
+    auto cached = memo_.find(node.id);
+    if (cached != memo_.end()) return cached->second;
+
+    const CppGrammar &g = cpp_grammar();
+    auto is_operator = [&](TSNode current) {
+        TSSymbol type = ts_node_symbol(current);
+        return type == g.binary_expression || type == g.unary_expression || type == g.parenthesized_expression ||
+               type == g.conditional_expression || type == g.cast_expression || type == g.condition_clause ||
+               (type == g.sizeof_expression && ts_node_is_null(ts_node_child_by_field_id(current, g.field_type)));
+    };
+    values_.clear();
+    frames_.clear();
+    walker_.walk(node, [&](TSNode current, uint32_t depth) {
+        if (depth > 0 && (!ts_node_is_named(current) || ts_node_is_extra(current))) return Visit::SkipChildren;
+        if (ts_node_symbol(current) == g.type_descriptor) return Visit::SkipChildren;
+        if (depth > 0) {
+            auto hit = memo_.find(current.id);
+            if (hit != memo_.end()) {
+                values_.push_back(hit->second);
+                return Visit::SkipChildren;
+            }
+        }
+        if (is_operator(current)) {
+            frames_.push_back({current.id, values_.size()});
+            return Visit::Continue;
+        }
+        values_.push_back(leaf(current));
+        return Visit::SkipChildren;
+    }, [&](TSNode current, uint32_t) {
+        if (frames_.empty() || frames_.back().id != current.id) return;
+        size_t base = frames_.back().base;
+        frames_.pop_back();
+        ConstantValue result = combine(current, values_.data() + base, values_.size() - base);
+        memo_[current.id] = result;
+        values_.resize(base);
+        values_.push_back(result);
+    });
+    return values_.empty() ? ConstantValue() : values_.back();
+}
+
+int evaluate_expression(TSNode node, std::string_view code, const std::unordered_map<std::string, int>& variables) {
+    ConstantEvaluator evaluator(code);
+    for (const auto &variable : variables) {
+        evaluator.set_variable(variable.first, ConstantValue::of(static_cast<uint64_t>(static_cast<int64_t>(variable.second))));
+    }
+    ConstantValue value = evaluator.evaluate(node);
+    return value.known() ? static_cast<int>(value.as_signed()) : 0;
+}
+
+bool is_constant_true(TSNode condition, std::string_view code, const std::unordered_map<std::string, int>& variables) {
+    ConstantEvaluator evaluator(code);
+    for (const auto &variable : variables) {
+        evaluator.set_variable(variable.first, ConstantValue::of(static_cast<uint64_t>(static_cast<int64_t>(variable.second))));
+    }
+    return evaluator.evaluate(condition).is_true();
+}
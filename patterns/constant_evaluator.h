@@ -1,13 +1,113 @@
 #pragma once
 #include "common.h"
-#include <cstdlib>
+#include "visitor.h"
 #include <unordered_map>
 #include <string>
-#include <algorithm>
-#include <cctype>
-
-// Evaluates a basic arithmetic expression from the AST.
-// Only supports number literals, identifiers (looked up in variables),
-// binary expressions with +, -, *, /, and parenthesized expressions.
-int evaluate_expression(TSNode, const std::string&, const std::unordered_map<std::string, int>&);
-bool is_constant_true(TSNode, const std::string&, const std::unordered_map<std::string, int>&);
\ No newline at end of file
+
+// Integer type of a folded value after the usual promotions: everything
+// narrower than int is folded as int, so only two widths remain.
+struct ConstantType {
+    uint8_t bits = 32; // 32 or 64
+    bool is_unsigned = false;
+
+    bool operator==(const ConstantType &other) const { return bits == other.bits && is_unsigned == other.is_unsigned; }
+};
+
+// A folded expression. `bits` holds the value in two's complement, sign- or
+// zero-extended from the type's width, so a signed value reads back through
+// as_signed() and an unsigned one through `bits`.
+struct ConstantValue {
+    enum Status : uint8_t {
+        Unknown,  // depends on something that is not a compile-time constant
+        Known,
+        Overflow, // undefined: signed overflow, division by zero, out-of-range shift
+    };
+    Status status = Unknown;
+    ConstantType type;
+    uint64_t bits = 0;
+
+    // `value` truncated to `type`.
+    static ConstantValue of(uint64_t value, ConstantType type = ConstantType());
+    static ConstantValue overflow() { return {Overflow, ConstantType(), 0}; }
+
+    bool known() const { return status == Known; }
+    int64_t as_signed() const { return static_cast<int64_t>(bits); }
+    bool is_true() const { return known() && bits != 0; }
+    bool is_false() const { return known() && bits == 0; }
+};
+
+// Value of an integer, character, `true` or `false` literal: decimal, hex,
+// octal and binary bases, ' digit separators, and u/l/ll/z suffixes choose the
+// type as the standard does (the first of int, long, ... that holds it).
+// Floating-point and malformed literals are Unknown; one too large for any
+// type is Overflow.
+ConstantValue parse_integer_literal(std::string_view text);
+
+// Folds `left op right` / `op operand` with C++ semantics on the promoted types:
+// unsigned arithmetic wraps, signed overflow is reported, comparisons and
+// logical operators yield int. `&&`, `||` settle on one known operand when it
+// decides the result.
+ConstantValue fold_binary(std::string_view op, const ConstantValue &left, const ConstantValue &right);
+ConstantValue fold_unary(std::string_view op, const ConstantValue &operand);
+
+// Converts a known value to `type`, wrapping like an integral conversion.
+ConstantValue convert_constant(const ConstantValue &value, ConstantType type);
+
+// Converts to the type spelled `type` (primitive, fixed-width or size
+// typedef, as in a cast or declaration). Unknown for any other type.
+ConstantValue cast_constant(const ConstantValue &value, std::string_view type);
+
+// Decimal text of a known value, signed or unsigned as its type; empty otherwise.
+std::string constant_text(const ConstantValue &value);
+
+class ConstantEnvironment;
+
+// Folds expressions of one file. Handles literals, variables given with
+// set_variable, binary, unary, conditional, parenthesized and cast
+// expressions, sizeof on primitive types and on typed operands, and the
+// condition clause of an if/while. The walk is iterative, so depth is bounded
+// only by the tree; every folded operator node is memoized by its id, so
+// asking again for an expression or for any subexpression of one already
+// folded costs a lookup. Ids belong to one tree: call reset when moving to
+// another tree or source.
+class ConstantEvaluator {
+public:
+    explicit ConstantEvaluator(std::string_view code = std::string_view()) : code_(code) {}
+
+    void reset(std::string_view code);
+    // Drops memoized results, which may have used the old value.
+    void set_variable(std::string_view name, const ConstantValue &value);
+    // Identifiers are looked up by name and position in `environment` (which
+    // must outlive the evaluations) before the variables above; null detaches
+    // it. Drops memoized results.
+    void set_environment(const ConstantEnvironment *environment);
+
+    ConstantValue evaluate(TSNode node);
+
+    size_t memoized() const { return memo_.size(); }
+
+private:
+    ConstantValue leaf(TSNode node) const;
+    ConstantValue combine(TSNode node, const ConstantValue *operands, size_t count) const;
+
+    // An operator node whose operands are being folded: their values sit on
+    // values_ from `base` up.
+    struct Frame {
+        const void *id;
+        size_t base;
+    };
+
+    std::string_view code_;
+    std::unordered_map<std::string, ConstantValue> variables_;
+    const ConstantEnvironment *environment_ = nullptr;
+    std::unordered_map<const void *, ConstantValue> memo_;
+    std::vector<ConstantValue> values_;
+    std::vector<Frame> frames_;
+    TreeWalker walker_;
+};
+
+// Folds `node` as an int with `variables` known; 0 when the value is unknown
+// or overflows.
+int evaluate_expression(TSNode, std::string_view, const std::unordered_map<std::string, int>&);
+// True only when the condition folds to a known non-zero value.
+bool is_constant_true(TSNode, std::string_view, const std::unordered_map<std::string, int>&);
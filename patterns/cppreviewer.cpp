@@ -0,0 +1,93 @@
+#include "cppreviewer.h"
+#include "analyzer.h"
+#include "callgraph.h"
+#include "parser_pool.h"
+#include "session.h"
+#include "version.h"
+#include <mutex>
+
+namespace cppreviewer {
+
+static AnalysisOptions to_internal(const Options &options) {
+    AnalysisOptions internal;
+    internal.memory = options.memory;
+    internal.functions = options.functions;
+    internal.return_function = options.return_function;
+    internal.return_summaries = options.return_summaries;
+    internal.rules = options.rules;
+    return internal;
+}
+
+static Result to_public(const AnalysisResult &internal) {
+    Result result;
+    result.warnings = internal.warnings;
+    result.functions.reserve(internal.functions.size());
+    for (const FunctionInfo &info : internal.functions) {
+        result.functions.push_back({info.name, info.declaration});
+    }
+    result.return_values = internal.return_values;
+    result.return_summaries.reserve(internal.return_summaries.size());
+    for (const ::ReturnSummary &summary : internal.return_summaries) {
+        result.return_summaries.push_back(
+            {summary.name, summary.value, summary.returns, constant_text(returned_constant(summary.constant, summary.type))});
+    }
+    return result;
+}
+
+const char *version() {
+    return CPPREVIEWER_VERSION;
+}
+
+struct Session::Impl {
+    Impl(const Options &options, unsigned parsers)
+        : options(to_internal(options)), pool(parsers), files(this->options, &pool) {}
+
+    AnalysisOptions options;
+    ParserPool pool;
+    std::mutex files_mutex;
+    AnalysisSession files;
+    CallGraph calls;
+};
+
+Session::Session(const Options &options, unsigned parsers) : impl_(new Impl(options, parsers)) {}
+Session::~Session() = default;
+Session::Session(Session &&) noexcept = default;
+Session &Session::operator=(Session &&) noexcept = default;
+
+Result Session::analyze(std::string_view code) const {
+    AnalysisResult result;
+    analyze_code(impl_->pool.acquire(), code, result, impl_->options);
+    return to_public(result);
+}
+
+Result Session::analyze(std::string_view code, const Options &options) const {
+    AnalysisResult result;
+    analyze_code(impl_->pool.acquire(), code, result, to_internal(options));
+    return to_public(result);
+}
+
+Result Session::update(const std::string &path, std::string_view code) {
+    std::lock_guard<std::mutex> lock(impl_->files_mutex);
+    const AnalysisResult &result = impl_->files.update(path, code);
+    impl_->calls.set_file(path, result.return_summaries);
+    return to_public(result);
+}
+
+void Session::forget(const std::string &path) {
+    std::lock_guard<std::mutex> lock(impl_->files_mutex);
+    impl_->files.forget(path);
+    impl_->calls.remove_file(path);
+}
+
+std::vector<ReturnSummary> Session::resolve_returns(unsigned jobs) {
+    std::lock_guard<std::mutex> lock(impl_->files_mutex);
+    impl_->calls.solve(jobs);
+    std::vector<ReturnSummary> resolved;
+    resolved.reserve(impl_->calls.results().size());
+    for (const ResolvedReturn &result : impl_->calls.results()) {
+        resolved.push_back({result.name, result.value, result.returns, constant_text(result.constant)});
+    }
+    return resolved;
+}
+
+} // namespace cppreviewer
@@ -0,0 +1,95 @@
+#pragma once
+// Embeddable interface to the analyzers. This is the only header a client
+// needs: it exposes no tree-sitter types and no internal classes, and every
+// class keeps its state behind a pointer, so the library can change inside
+// without clients having to recompile against new layouts.
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(_WIN32) && defined(CPPREVIEWER_SHARED)
+#  ifdef CPPREVIEWER_BUILDING
+#    define CPPREVIEWER_API __declspec(dllexport)
+#  else
+#    define CPPREVIEWER_API __declspec(dllimport)
+#  endif
+#elif defined(__GNUC__)
+#  define CPPREVIEWER_API __attribute__((visibility("default")))
+#else
+#  define CPPREVIEWER_API
+#endif
+
+namespace cppreviewer {
+
+// Which analyses to run.
+struct Options {
+    bool memory = true;           // leak / use-after-free / DP heuristics
+    bool functions = false;       // function cross-reference table
+    std::string return_function;  // collect this function's return value when non-empty
+    bool return_summaries = false; // first return value of every function definition
+    std::string rules;            // tree-sitter query patterns reported as warnings, none when empty
+};
+
+struct Function {
+    std::string name;
+    std::string declaration;
+};
+
+struct ReturnSummary {
+    std::string name;  // qualified with enclosing namespaces and classes
+    std::string value; // returned expression; empty for `return;` or when none is reached
+    bool returns;      // a return statement was reached
+    std::string constant; // decimal value returned when it folds to a constant, empty otherwise
+};
+
+struct Result {
+    std::vector<std::string> warnings;
+    std::vector<Function> functions;
+    std::vector<std::string> return_values;
+    std::vector<ReturnSummary> return_summaries; // sorted by name
+};
+
+// Library version; changes whenever results for the same input may differ.
+CPPREVIEWER_API const char *version();
+
+// Long-lived analysis context. A session pools parsers, so after the first few
+// calls analyzing a buffer costs the parse and walk only.
+//
+// analyze() keeps no state and may be called from any number of threads at
+// once. update() and forget() track files between calls and reparse changed
+// files incrementally; they are serialized internally.
+class CPPREVIEWER_API Session {
+public:
+    // `parsers` are created up front; more are made if more threads analyze at once.
+    explicit Session(const Options &options = Options(), unsigned parsers = 1);
+    ~Session();
+    Session(Session &&) noexcept;
+    Session &operator=(Session &&) noexcept;
+    Session(const Session &) = delete;
+    Session &operator=(const Session &) = delete;
+
+    // Analyzes one buffer with the session's options, or with `options`.
+    Result analyze(std::string_view code) const;
+    Result analyze(std::string_view code, const Options &options) const;
+
+    // Analyzes `code` as the current contents of `path`, reusing the file's
+    // previous tree and per-declaration results when it was seen before.
+    Result update(const std::string &path, std::string_view code);
+
+    // Drops everything kept for `path`.
+    void forget(const std::string &path);
+
+    // Every function of the files tracked by update() (analyzed with
+    // return_summaries), with `constant` following calls between them: a
+    // function returning `helper()` returns what `helper` does. Each file is
+    // analyzed only when updated; resolving relinks the call graph, which is
+    // linear in functions and calls.
+    std::vector<ReturnSummary> resolve_returns(unsigned jobs = 0);
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+} // namespace cppreviewer
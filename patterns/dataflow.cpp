@@ -0,0 +1,484 @@
+#include "dataflow.h"
+#include "visitor.h"
+#include <algorithm>
+#include <deque>
+#include <unordered_map>
+#include <memory_resource>
+
+static const uint32_t unreachable = UINT32_MAX;
+
+namespace {
+
+// Builds the graph with an explicit stack of statement frames instead of
+// recursion, so generated code nested a million levels deep cannot overflow
+// the call stack. Each frame is resumed with the block its last child statement
+// ended in and either asks for another child or finishes with its own end
+// block. Blocks are created in the same order a recursive descent would.
+class FlowBuilder {
+public:
+    FlowBuilder(FlowGraph &graph, std::string_view code, std::pmr::memory_resource *memory)
+        : edges(memory), graph_(graph), code_(code), g_(cpp_grammar()), frames_(memory), children_(memory),
+          breaks_(memory), continues_(memory), labels_(memory), gotos_(memory) {
+        graph_.blocks.push_back({0, 0}); // entry
+        graph_.blocks.push_back({0, 0}); // exit
+    }
+
+    void build(TSNode body) {
+        uint32_t end = add(body, FlowGraph::entry);
+        edge(end, FlowGraph::exit);
+        for (const auto &[from, label] : gotos_) {
+            auto target = labels_.find(label);
+            edge(from, target != labels_.end() ? target->second : FlowGraph::exit);
+        }
+    }
+
+    std::pmr::vector<std::pair<uint32_t, uint32_t>> edges;
+
+private:
+    // A statement whose children are still being added.
+    struct Frame {
+        TSNode node;
+        TSSymbol type;
+        uint32_t stage;
+        uint32_t from;               // running flow for sequences
+        uint32_t a, b, c;            // per-statement blocks, see step()
+        uint32_t first, next, end;   // queued children, as a range of children_
+        bool has_default;
+    };
+
+    uint32_t block(uint32_t start_byte, uint32_t end_byte) {
+        graph_.blocks.push_back({start_byte, end_byte});
+        return static_cast<uint32_t>(graph_.blocks.size() - 1);
+    }
+
+    uint32_t join() { return block(0, 0); }
+
+    void edge(uint32_t from, uint32_t to) {
+        if (from != unreachable && to != unreachable) edges.emplace_back(from, to);
+    }
+
+    // A block for `node`'s bytes entered from `from`; a null node adds nothing.
+    uint32_t segment(TSNode node, uint32_t from) {
+        if (ts_node_is_null(node) || from == unreachable) return from;
+        uint32_t b = block(ts_node_start_byte(node), ts_node_end_byte(node));
+        edge(from, b);
+        return b;
+    }
+
+    TSNode field(TSNode node, TSFieldId id) const { return ts_node_child_by_field_id(node, id); }
+
+    Frame &push(TSNode node, TSSymbol type, uint32_t from) {
+        uint32_t first = static_cast<uint32_t>(children_.size());
+        frames_.push_back({node, type, 0, from, unreachable, unreachable, unreachable, first, first, first, false});
+        return frames_.back();
+    }
+
+    // Queues `parent`'s children other than `except` for `frame`, the top one.
+    void queue_children(Frame &frame, TSNode parent, TSNode except, bool named_only) {
+        for_each_child(parent, [&](TSNode child) {
+            if ((!named_only || ts_node_is_named(child)) && !ts_node_eq(child, except)) children_.push_back(child);
+        });
+        frame.end = static_cast<uint32_t>(children_.size());
+    }
+
+    void push_loop(uint32_t next, uint32_t after) {
+        continues_.push_back(next);
+        breaks_.push_back(after);
+    }
+
+    void pop_loop() {
+        breaks_.pop_back();
+        continues_.pop_back();
+    }
+
+    // Adds `statement` reached from `from`. Simple statements are finished
+    // here and their end block stored in `result`; compound ones push a frame
+    // and return false.
+    bool start(TSNode statement, uint32_t from, uint32_t &result) {
+        result = from;
+        if (ts_node_is_null(statement)) return true;
+        TSSymbol type = ts_node_symbol(statement);
+        if (type == g_.comment) return true;
+
+        if (type == g_.compound_statement) {
+            queue_children(push(statement, type, from), statement, TSNode{}, true);
+            return false;
+        }
+        if (type == g_.labeled_statement) {
+            TSNode label = field(statement, g_.field_label);
+            uint32_t target = join();
+            edge(from, target);
+            labels_[node_text(label, code_)] = target;
+            queue_children(push(statement, type, target), statement, label, true);
+            return false;
+        }
+        if (type == g_.case_statement) {
+            queue_children(push(statement, type, from), statement, field(statement, g_.field_value), true);
+            return false;
+        }
+        if (type == g_.if_statement || type == g_.while_statement || type == g_.for_statement ||
+            type == g_.for_range_loop || type == g_.do_statement || type == g_.switch_statement ||
+            type == g_.try_statement) {
+            push(statement, type, from);
+            return false;
+        }
+        if (type == g_.break_statement) {
+            if (!breaks_.empty()) edge(from, breaks_.back());
+            result = unreachable;
+            return true;
+        }
+        if (type == g_.continue_statement) {
+            if (!continues_.empty()) edge(from, continues_.back());
+            result = unreachable;
+            return true;
+        }
+        if (type == g_.return_statement) {
+            edge(segment(statement, from), FlowGraph::exit);
+            result = unreachable;
+            return true;
+        }
+        if (type == g_.goto_statement) {
+            if (from != unreachable) gotos_.emplace_back(from, node_text(field(statement, g_.field_label), code_));
+            result = unreachable;
+            return true;
+        }
+        // Expression statements, declarations and anything not modelled above
+        // run straight through as one block.
+        result = segment(statement, from);
+        return true;
+    }
+
+    // Advances the top frame. `result` is the end block of the child it asked
+    // for last (`resumed` is false on its first step). Either stores the next
+    // child to add in (`child`, `child_from`) and returns false, or pops the
+    // frame, stores its own end block in `result` and returns true.
+    bool step(bool resumed, uint32_t &result, TSNode &child, uint32_t &child_from) {
+        Frame &f = frames_.back();
+        auto ask = [&](TSNode node, uint32_t from) {
+            f.stage++;
+            child = node;
+            child_from = from;
+            return false;
+        };
+        auto finish = [&](uint32_t end) {
+            children_.resize(f.first);
+            result = end;
+            return true;
+        };
+
+        if (f.type == g_.compound_statement || f.type == g_.labeled_statement || f.type == g_.case_statement) {
+            if (resumed) f.from = result;
+            if (f.next < f.end) return ask(children_[f.next++], f.from);
+            return finish(f.from);
+        }
+        if (f.type == g_.if_statement) {
+            // a: condition, b: end of the then branch
+            if (f.stage == 0) {
+                f.a = segment(field(f.node, g_.field_condition), f.from);
+                return ask(field(f.node, g_.field_consequence), f.a);
+            }
+            if (f.stage == 1) {
+                f.b = result;
+                TSNode alternative = field(f.node, g_.field_alternative);
+                if (!ts_node_is_null(alternative)) {
+                    // else_clause wraps the statement
+                    if (ts_node_symbol(alternative) == g_.else_clause) alternative = ts_node_named_child(alternative, 0);
+                    return ask(alternative, f.a);
+                }
+                result = f.a;
+            }
+            uint32_t after = join();
+            edge(f.b, after);
+            edge(result, after);
+            return finish(after);
+        }
+        if (f.type == g_.while_statement) {
+            // a: head, b: after
+            if (f.stage == 0) {
+                f.a = join();
+                edge(f.from, f.a);
+                uint32_t condition = segment(field(f.node, g_.field_condition), f.a);
+                f.b = join();
+                edge(condition, f.b);
+                push_loop(f.a, f.b);
+                return ask(field(f.node, g_.field_body), condition);
+            }
+            edge(result, f.a);
+            pop_loop();
+            return finish(f.b);
+        }
+        if (f.type == g_.for_statement) {
+            // a: head, b: after, c: next (continue target, runs the update)
+            if (f.stage == 0) {
+                uint32_t init = segment(field(f.node, g_.field_initializer), f.from);
+                f.a = join();
+                edge(init, f.a);
+                TSNode condition_node = field(f.node, g_.field_condition);
+                uint32_t condition = segment(condition_node, f.a);
+                f.b = join();
+                if (!ts_node_is_null(condition_node)) edge(condition, f.b);
+                f.c = join();
+                push_loop(f.c, f.b);
+                return ask(field(f.node, g_.field_body), condition);
+            }
+            edge(result, f.c);
+            pop_loop();
+            edge(segment(field(f.node, g_.field_update), f.c), f.a);
+            return finish(f.b);
+        }
+        if (f.type == g_.for_range_loop) {
+            // a: head, b: after
+            if (f.stage == 0) {
+                uint32_t range = segment(field(f.node, g_.field_right), f.from);
+                f.a = join();
+                edge(range, f.a);
+                f.b = join();
+                edge(f.a, f.b);
+                push_loop(f.a, f.b);
+                return ask(field(f.node, g_.field_body), f.a);
+            }
+            edge(result, f.a);
+            pop_loop();
+            return finish(f.b);
+        }
+        if (f.type == g_.do_statement) {
+            // a: head, b: after, c: next (continue target, runs the condition)
+            if (f.stage == 0) {
+                f.a = join();
+                edge(f.from, f.a);
+                f.c = join();
+                f.b = join();
+                push_loop(f.c, f.b);
+                return ask(field(f.node, g_.field_body), f.a);
+            }
+            edge(result, f.c);
+            pop_loop();
+            uint32_t condition = segment(field(f.node, g_.field_condition), f.c);
+            edge(condition, f.a);
+            edge(condition, f.b);
+            return finish(f.b);
+        }
+        if (f.type == g_.switch_statement) {
+            // a: condition, b: after, c: fallthrough into the next case
+            if (f.stage == 0) {
+                f.a = segment(field(f.node, g_.field_condition), f.from);
+                f.b = join();
+                breaks_.push_back(f.b);
+                queue_children(f, field(f.node, g_.field_body), TSNode{}, false);
+            } else {
+                f.c = result;
+            }
+            while (f.next < f.end) {
+                TSNode node = children_[f.next++];
+                if (ts_node_symbol(node) == g_.case_statement) {
+                    if (ts_node_is_null(field(node, g_.field_value))) f.has_default = true;
+                    uint32_t entry = join();
+                    edge(f.a, entry);
+                    edge(f.c, entry);
+                    return ask(node, entry);
+                }
+                if (ts_node_is_named(node)) return ask(node, f.c);
+            }
+            breaks_.pop_back();
+            if (!f.has_default) edge(f.a, f.b);
+            edge(f.c, f.b);
+            return finish(f.b);
+        }
+        // try_statement; a: entry of the try block (handlers start there too), b: after
+        if (f.stage == 0) {
+            f.a = join();
+            edge(f.from, f.a);
+            f.b = join();
+            for_each_child(f.node, [&](TSNode node) {
+                if (ts_node_symbol(node) == g_.catch_clause) children_.push_back(node);
+            });
+            f.end = static_cast<uint32_t>(children_.size());
+            return ask(field(f.node, g_.field_body), f.a);
+        }
+        edge(result, f.b);
+        if (f.next < f.end) return ask(field(children_[f.next++], g_.field_body), f.a);
+        return finish(f.b);
+    }
+
+    // Adds `statement` reached from `from` and returns the block control
+    // continues from afterwards, or `unreachable`.
+    uint32_t add(TSNode statement, uint32_t from) {
+        uint32_t result;
+        if (start(statement, from, result)) return result;
+        bool resumed = false;
+        while (!frames_.empty()) {
+            TSNode child;
+            uint32_t child_from;
+            if (step(resumed, result, child, child_from)) {
+                frames_.pop_back();
+                resumed = true;
+            } else {
+                resumed = start(child, child_from, result);
+            }
+        }
+        return result;
+    }
+
+    FlowGraph &graph_;
+    std::string_view code_;
+    const CppGrammar &g_;
+    std::pmr::vector<Frame> frames_;
+    std::pmr::vector<TSNode> children_; // queued children of every open frame, innermost last
+    std::pmr::vector<uint32_t> breaks_;
+    std::pmr::vector<uint32_t> continues_;
+    std::pmr::unordered_map<std::string_view, uint32_t> labels_;
+    std::pmr::vector<std::pair<uint32_t, std::string_view>> gotos_;
+};
+
+} // namespace
+
+uint32_t FlowGraph::block_at(uint32_t byte) const {
+    auto it = std::upper_bound(by_start_.begin(), by_start_.end(), byte,
+                               [&](uint32_t b, uint32_t block) { return b < blocks[block].start_byte; });
+    if (it == by_start_.begin()) return UINT32_MAX;
+    uint32_t block = *(it - 1);
+    return byte < blocks[block].end_byte ? block : UINT32_MAX;
+}
+
+FlowGraph build_flow_graph(TSNode body, std::string_view code) {
+    std::pmr::memory_resource *memory = analysis_memory();
+    FlowGraph graph(memory);
+    FlowBuilder builder(graph, code, memory);
+    builder.build(body);
+
+    uint32_t count = static_cast<uint32_t>(graph.blocks.size());
+    graph.successor_offsets.assign(count + 1, 0);
+    for (const auto &[from, to] : builder.edges) graph.successor_offsets[from + 1]++;
+    for (uint32_t b = 0; b < count; b++) graph.successor_offsets[b + 1] += graph.successor_offsets[b];
+    graph.successors.resize(builder.edges.size());
+    std::pmr::vector<uint32_t> fill(graph.successor_offsets.begin(), graph.successor_offsets.end() - 1, memory);
+    for (const auto &[from, to] : builder.edges) graph.successors[fill[from]++] = to;
+
+    for (uint32_t b = 2; b < count; b++) {
+        if (graph.blocks[b].end_byte > graph.blocks[b].start_byte) graph.by_start_.push_back(b);
+    }
+    std::sort(graph.by_start_.begin(), graph.by_start_.end(),
+              [&](uint32_t a, uint32_t b) { return graph.blocks[a].start_byte < graph.blocks[b].start_byte; });
+    return graph;
+}
+
+namespace {
+
+// Per-block state: two bit vectors of `words` words each, live then freed.
+class BitStates {
+public:
+    BitStates(size_t blocks, size_t words, std::pmr::memory_resource *memory)
+        : words_(words), bits_(blocks * words * 2, 0, memory) {}
+    uint64_t *live(size_t block) { return &bits_[block * words_ * 2]; }
+    uint64_t *freed(size_t block) { return &bits_[block * words_ * 2 + words_]; }
+
+private:
+    size_t words_;
+    std::pmr::vector<uint64_t> bits_;
+};
+
+bool test(const uint64_t *bits, uint32_t v) { return (bits[v >> 6] >> (v & 63)) & 1; }
+void set(uint64_t *bits, uint32_t v) { bits[v >> 6] |= uint64_t(1) << (v & 63); }
+void clear(uint64_t *bits, uint32_t v) { bits[v >> 6] &= ~(uint64_t(1) << (v & 63)); }
+
+} // namespace
+
+std::pmr::vector<PointerIssue> analyze_pointers(const FlowGraph &graph, const std::pmr::vector<PointerEvent> &events,
+                                                uint32_t variable_count, const std::pmr::vector<bool> &track_leaks) {
+    std::pmr::memory_resource *memory = analysis_memory();
+    std::pmr::vector<PointerIssue> issues(memory);
+    size_t block_count = graph.blocks.size();
+    size_t words = (variable_count + 63) / 64;
+    if (words == 0) return issues;
+
+    // Events of each block, as a range of `events` (they are sorted by byte
+    // and blocks do not overlap, so each block's events are contiguous).
+    std::pmr::vector<uint32_t> first_event(block_count, 0, memory), end_event(block_count, 0, memory);
+    std::pmr::vector<uint32_t> last_allocation(variable_count, 0, memory);
+    for (uint32_t e = 0; e < events.size(); e++) {
+        if (events[e].kind == PointerEvent::Allocate) last_allocation[events[e].variable] = e;
+        uint32_t block = graph.block_at(events[e].byte);
+        if (block == UINT32_MAX) continue;
+        if (end_event[block] == 0) first_event[block] = e;
+        end_event[block] = e + 1;
+    }
+
+    // Applies a block's events to (live, freed); reports issues when `issues_out` is set.
+    auto transfer = [&](uint32_t block, uint64_t *live, uint64_t *freed, std::pmr::vector<PointerIssue> *issues_out) {
+        for (uint32_t e = first_event[block]; e < end_event[block]; e++) {
+            const PointerEvent &event = events[e];
+            uint32_t v = event.variable;
+            switch (event.kind) {
+                case PointerEvent::Allocate:
+                    set(live, v);
+                    clear(freed, v);
+                    break;
+                case PointerEvent::Free:
+                case PointerEvent::Delete:
+                    if (issues_out) {
+                        if (test(freed, v)) issues_out->push_back({PointerIssue::DoubleFree, e, v});
+                        else if (!test(live, v)) issues_out->push_back({PointerIssue::NeverOwned, e, v});
+                    }
+                    clear(live, v);
+                    set(freed, v);
+                    break;
+                case PointerEvent::Escape:
+                case PointerEvent::Rebind:
+                    clear(live, v);
+                    clear(freed, v);
+                    break;
+            }
+        }
+    };
+
+    // in[b] is the union of out[p] over predecessors; iterate to a fixpoint.
+    BitStates in(block_count, words, memory);
+    std::pmr::vector<uint64_t> live(words, memory), freed(words, memory);
+    std::pmr::deque<uint32_t> worklist(memory);
+    std::pmr::vector<bool> queued(block_count, false, memory), visited(block_count, false, memory);
+    worklist.push_back(FlowGraph::entry);
+    queued[FlowGraph::entry] = true;
+    while (!worklist.empty()) {
+        uint32_t block = worklist.front();
+        worklist.pop_front();
+        queued[block] = false;
+        visited[block] = true;
+        std::copy(in.live(block), in.live(block) + words, live.begin());
+        std::copy(in.freed(block), in.freed(block) + words, freed.begin());
+        transfer(block, live.data(), freed.data(), nullptr);
+        for (uint32_t s = graph.successor_offsets[block]; s < graph.successor_offsets[block + 1]; s++) {
+            uint32_t next = graph.successors[s];
+            bool changed = false;
+            uint64_t *next_live = in.live(next), *next_freed = in.freed(next);
+            for (size_t w = 0; w < words; w++) {
+                uint64_t merged_live = next_live[w] | live[w], merged_freed = next_freed[w] | freed[w];
+                changed |= merged_live != next_live[w] || merged_freed != next_freed[w];
+                next_live[w] = merged_live;
+                next_freed[w] = merged_freed;
+            }
+            // Every reachable block is visited once even if its input is empty.
+            if ((changed || !visited[next]) && !queued[next]) {
+                queued[next] = true;
+                worklist.push_back(next);
+            }
+        }
+    }
+
+    // Report from the fixpoint states, block by block in source order.
+    std::pmr::vector<uint32_t> order(memory);
+    for (uint32_t b = 2; b < block_count; b++) {
+        if (end_event[b] > first_event[b]) order.push_back(b);
+    }
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return first_event[a] < first_event[b]; });
+    for (uint32_t block : order) {
+        std::copy(in.live(block), in.live(block) + words, live.begin());
+        std::copy(in.freed(block), in.freed(block) + words, freed.begin());
+        transfer(block, live.data(), freed.data(), &issues);
+    }
+
+    const uint64_t *exit_live = in.live(FlowGraph::exit);
+    for (uint32_t v = 0; v < variable_count; v++) {
+        if (track_leaks[v] && test(exit_live, v)) issues.push_back({PointerIssue::Leak, last_allocation[v], v});
+    }
+    return issues;
+}
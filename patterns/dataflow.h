@@ -0,0 +1,78 @@
+#pragma once
+#include "common.h"
+#include "grammar.h"
+#include "arena.h"
+
+// Control-flow graph of one function body. Every simple statement, and every
+// condition, initializer or update clause of a compound statement, becomes
+// one block covering its bytes; empty blocks join branches and head loops.
+// Blocks never overlap, so a byte inside the body belongs to at most one
+// block. Successors are kept as CSR (offsets into one target list). All
+// storage comes from analysis_memory(), so a graph built inside an ArenaScope
+// must not outlive it.
+struct FlowGraph {
+    static const uint32_t entry = 0;
+    static const uint32_t exit = 1;
+
+    struct Block {
+        uint32_t start_byte;
+        uint32_t end_byte; // equal to start_byte for join blocks
+    };
+
+    explicit FlowGraph(std::pmr::memory_resource *memory = analysis_memory())
+        : blocks(memory), successor_offsets(memory), successors(memory), by_start_(memory) {}
+
+    std::pmr::vector<Block> blocks;
+    std::pmr::vector<uint32_t> successor_offsets; // blocks.size() + 1 entries
+    std::pmr::vector<uint32_t> successors;
+
+    // Block whose bytes contain `byte`, or UINT32_MAX.
+    uint32_t block_at(uint32_t byte) const;
+
+private:
+    friend FlowGraph build_flow_graph(TSNode body, std::string_view code);
+    std::pmr::vector<uint32_t> by_start_; // non-empty blocks sorted by start_byte
+};
+
+// Builds the graph for a function body (a compound_statement). Handles if,
+// while, for, range-for, do, switch/case, break, continue, return, goto to
+// labels in the same body, and try/catch (a handler may be entered from
+// anywhere in the try block, approximated by its start). The size of the
+// graph is linear in the number of statements.
+FlowGraph build_flow_graph(TSNode body, std::string_view code);
+
+// What happens to a pointer variable at one point of a function.
+struct PointerEvent {
+    enum Kind {
+        Allocate, // assigned the result of an allocation
+        Free,     // passed to a deallocation function
+        Delete,   // operand of delete
+        Escape,   // returned or copied elsewhere; the function no longer owns it
+        Rebind,   // assigned something that is not an allocation
+    };
+    Kind kind;
+    uint32_t byte;
+    uint32_t variable;
+};
+
+// A finding of analyze_pointers.
+struct PointerIssue {
+    enum Kind {
+        DoubleFree,  // freed while it may already have been freed on some path
+        NeverOwned,  // freed while no allocation reaches it on any path
+        Leak,        // may still own an allocation when the function returns
+    };
+    Kind kind;
+    uint32_t event;    // index of the offending event; for Leak, the variable's last allocation
+    uint32_t variable;
+};
+
+// Forward "may" dataflow over `graph` with two bits per variable: the
+// variable may hold a live allocation, or may have been freed. States are
+// bit vectors joined by union, and a worklist visits each block again only
+// when its input grows, so the cost is O(blocks * variables / 64) per pass
+// with few passes (bounded by loop nesting). `events` must be sorted by byte.
+// Issues come back in source order, leaks (checked at the exit block, only
+// for variables with `track_leaks[variable]`) last.
+std::pmr::vector<PointerIssue> analyze_pointers(const FlowGraph &graph, const std::pmr::vector<PointerEvent> &events,
+                                                uint32_t variable_count, const std::pmr::vector<bool> &track_leaks);
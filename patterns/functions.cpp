@@ -1,96 +1,134 @@
-#include "common.h"
+#include "functions.h"
 #include <iomanip>
-std::string find_identifier(TSNode node, const std::string& code) {
-    if (std::string(ts_node_type(node)) == "identifier")
-        return ts_node_string(node, code);
-    uint32_t count = ts_node_child_count(node);
-    for (uint32_t i = 0; i < count; ++i) {
-        TSNode child = ts_node_child(node, i);
-        std::string name = find_identifier(child, code);
-        if (!name.empty())
-            return name;
+
+std::string_view find_identifier(TSNode node, std::string_view code) {
+    const CppGrammar &g = cpp_grammar();
+    std::string_view name;
+    TreeWalker walker;
+    walker.walk(node, [&](TSNode current, uint32_t) {
+        if (ts_node_symbol(current) != g.identifier) return Visit::Continue;
+        name = node_text(current, code);
+        return Visit::Stop;
+    });
+    return name;
+}
+
+std::string_view defined_name(TSNode node, std::string_view code) {
+    const CppGrammar &g = cpp_grammar();
+    TSNode declarator = ts_node_child_by_field_id(node, g.field_declarator);
+    while (!ts_node_is_null(declarator) && ts_node_symbol(declarator) != g.function_declarator) {
+        declarator = ts_node_symbol(declarator) == g.reference_declarator ? ts_node_named_child(declarator, 0)
+                                                                          : ts_node_child_by_field_id(declarator, g.field_declarator);
     }
-    return "";
+    if (ts_node_is_null(declarator)) return std::string_view();
+    TSNode name = ts_node_child_by_field_id(declarator, g.field_declarator);
+    return ts_node_is_null(name) ? std::string_view() : node_text(name, code);
 }
 
-// Struct to hold collected function information
-struct FunctionInfo {
+std::string callee_name(TSNode call, std::string_view code) {
+    const CppGrammar &g = cpp_grammar();
+    TSNode function = ts_node_child_by_field_id(call, g.field_function);
+    if (ts_node_is_null(function)) return std::string();
+    TSSymbol type = ts_node_symbol(function);
+    if (type == g.field_expression) {
+        TSNode object = ts_node_child_by_field_id(function, g.field_argument);
+        if (ts_node_is_null(object) || ts_node_symbol(object) != g.this_expression) return std::string();
+        function = ts_node_child_by_field_id(function, g.field_field);
+        return ts_node_is_null(function) ? std::string() : ts_node_string(function, code);
+    }
+    if (type == g.template_function) {
+        function = ts_node_child_by_field_id(function, g.field_name);
+        if (ts_node_is_null(function)) return std::string();
+        type = ts_node_symbol(function);
+    }
+    if (type != g.identifier && type != g.qualified_identifier) return std::string();
     std::string name;
-    std::string declaration;
-};
-std::vector<FunctionInfo> functions;
-// Recursively traverses the syntax tree to collect functions.
-// It checks several node types: "template_declaration", "function_definition",
-// "declaration", and "function_declaration" to extract the function name
-// and its associated declaration text.
-void collect_functions(TSNode node, const std::string& code) {
-    std::string node_type = ts_node_type(node);
-    if (node_type=="field_declaration"){
-        if (ts_node_child_count(node) <=2) return;
-        TSNode primitive_type = ts_node_child(node, 0),
-               declarator = ts_node_child(node, 1);
-        if (!strcmp(ts_node_type(primitive_type), "primitive_type") &&
-            !strcmp(ts_node_type(declarator), "function_declarator")) {
-            std::string function_name = ts_node_string(ts_node_child(declarator, 0), code);
-            std::string declaration_text= ts_node_string(node, code);
-            auto it = std::find_if(functions.begin(), functions.end(), [&function_name, &declaration_text](const FunctionInfo& info) {
-                return info.name == function_name&& info.declaration == declaration_text;//yes of course templates
-            });
-            if (it == functions.end()) {
-                FunctionInfo info;
-                info.name = function_name;
-                info.declaration = declaration_text;
-                functions.push_back(info);
-            }
-        }
+    int angles = 0;
+    for (char c : node_text(function, code)) {
+        if (c == '<') angles++;
+        else if (c == '>' && angles > 0) angles--;
+        else if (angles == 0 && !isspace(static_cast<unsigned char>(c))) name += c;
     }
-    if ((node_type == "function_definition" || node_type == "function_declaration")) { // found a declarator & likely a function
-        std::string function_name = find_identifier(node, code);
-        std::string declaration_text;
-        if (node_type == "function_definition") {
-            TSNode primitive_type = ts_node_child(node, 0);
-            if (!strcmp(ts_node_type(primitive_type), "function_declarator")) {
-                if (ts_node_child_count(primitive_type) > 0&&
-                    !strcmp(ts_node_type(ts_node_child(primitive_type, 0)), "destructor_name"))
-                        function_name=ts_node_string(ts_node_child(primitive_type, 0), code);
-                size_t start_byte = ts_node_start_byte(primitive_type);
-                size_t end_byte = ts_node_end_byte(primitive_type);
-                declaration_text = code.substr(start_byte, end_byte - start_byte) + ";";
-                goto fine;
-            }
-            else{
-                TSNode func_decl = ts_node_child(node, 1);
-                if (!strcmp(ts_node_type(func_decl), "function_declarator")) {
-                    if (ts_node_child_count(func_decl) > 1 &&
-                        !strcmp(ts_node_type(ts_node_child(func_decl, 0)), "field_identifier"))
-                        function_name = ts_node_string(ts_node_child(func_decl, 0), code);
-                }
-                size_t start_byte = ts_node_start_byte(primitive_type);
-                size_t end_byte = ts_node_end_byte(func_decl);
-                declaration_text = code.substr(start_byte, end_byte - start_byte) + ";";
-            }
-        }
-        fine:
-        auto it = std::find_if(functions.begin(), functions.end(), [&function_name, &declaration_text](const FunctionInfo& info) {
-            return info.name == function_name&& info.declaration == declaration_text;//yes of course templates
-        });
-        if (it == functions.end()) {
-            FunctionInfo info;
-            info.name = function_name;
-            info.declaration = declaration_text;
-            functions.push_back(info);
-        }
+    return name;
+}
+
+FunctionTable::FunctionTable(std::vector<FunctionInfo>& functions, StringInterner* strings)
+    : functions_(functions),
+      own_strings_(strings ? nullptr : new StringInterner()),
+      strings_(strings ? strings : own_strings_.get()) {
+    index_.reserve(functions.size() * 2 + 16);
+    for (const FunctionInfo& info : functions) {
+        index_.insert(key(info.name, info.declaration));
     }
-    
-    // Recurse into children
-    uint32_t total_children = ts_node_child_count(node);
-    for (uint32_t i = 0; i < total_children; ++i) {
-        TSNode child = ts_node_child(node, i);
-        collect_functions(child, code);
+}
+
+uint64_t FunctionTable::key(std::string_view function_name, std::string_view declaration_text) {
+    return uint64_t(strings_->intern(function_name)) << 32 | strings_->intern(declaration_text);
+}
+
+bool FunctionTable::add(std::string_view function_name, std::string_view declaration_text) {
+    if (!index_.insert(key(function_name, declaration_text)).second) return false;
+    functions_.push_back(FunctionInfo{std::string(function_name), std::string(declaration_text)});
+    return true;
+}
+
+// Pattern 0: member declarations with a primitive return type; pattern 1:
+// function definitions. Declarations outside classes are not collected.
+static const char function_query[] =
+    "(field_declaration . (primitive_type) . (function_declarator . (_) @name)) @declaration\n"
+    "(function_definition declarator: (_) @declarator) @definition\n";
+
+static uint32_t capture(const char *name) {
+    return shared_query(function_query).capture_id(name);
+}
+
+std::vector<TSSymbol> FunctionChecker::subscriptions(const CppGrammar &) const {
+    return {};
+}
+
+std::string_view FunctionChecker::query() const {
+    return function_query;
+}
+
+// Extracts the function name and its declaration text. A definition's
+// declaration is its text up to the end of the declarator, plus ";".
+Visit FunctionChecker::match(const QueryMatch &match) {
+    static const uint32_t name = capture("name"), declaration = capture("declaration"),
+                          declarator = capture("declarator"), definition = capture("definition");
+    const CppGrammar &g = cpp_grammar();
+    std::string_view code = code_;
+    if (match.pattern == 0) {
+        functions_.add(node_text(match.capture(name), code), node_text(match.capture(declaration), code));
+        return Visit::Continue;
+    }
+
+    TSNode current = match.capture(definition);
+    TSNode function_declarator = match.capture(declarator);
+    std::string_view function_name = find_identifier(current, code);
+    if (ts_node_symbol(function_declarator) == g.function_declarator) {
+        TSNode inner = ts_node_child_by_field_id(function_declarator, g.field_declarator);
+        TSSymbol inner_symbol = ts_node_symbol(inner);
+        if (inner_symbol == g.destructor_name || inner_symbol == g.field_identifier) {
+            function_name = node_text(inner, code);
+        }
     }
+    size_t start_byte = ts_node_start_byte(current);
+    size_t end_byte = ts_node_end_byte(function_declarator);
+    declaration_.assign(code.substr(start_byte, end_byte - start_byte)).append(";");
+    functions_.add(function_name, declaration_);
+    return Visit::Continue;
 }
+
+// Runs a FunctionChecker on its own over `node`.
+void collect_functions(TSNode node, std::string_view code, std::vector<FunctionInfo>& functions) {
+    FunctionChecker checker(functions);
+    CheckerPipeline pipeline;
+    pipeline.add(checker);
+    pipeline.run(node, code);
+}
+
 // Print the collected functions in a table-like format
-void print_function_table() {
+void print_function_table(const std::vector<FunctionInfo>& functions) {
     std::cout << "-------------------------------------------------------------\n";
     std::cout << std::left << std::setw(30) << "Function Name" << std::setw(60) << "Declaration" << "\n";
     std::cout << "-------------------------------------------------------------\n";
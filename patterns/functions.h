@@ -0,0 +1,74 @@
+#pragma once
+#include "common.h"
+#include "checker.h"
+#include "interner.h"
+#include <unordered_set>
+
+// Struct to hold collected function information
+struct FunctionInfo {
+    std::string name;
+    std::string declaration;
+};
+
+// Text of the first `identifier` in `node`'s subtree (pre-order), or "".
+std::string_view find_identifier(TSNode node, std::string_view code);
+
+// The name a function definition or declaration declares, through any
+// pointer or reference declarators around its function_declarator: an
+// identifier, a qualified name for out-of-line members, an operator or
+// destructor name. Empty when `node` declares no function.
+std::string_view defined_name(TSNode node, std::string_view code);
+
+// Name of the function a call_expression calls: a plain or qualified
+// identifier with any template arguments dropped, or a member called through
+// `this`. Empty for calls through objects, pointers and other expressions,
+// which cannot be resolved by name.
+std::string callee_name(TSNode call, std::string_view code);
+
+// Hash index over a FunctionInfo vector so that "append unless this exact
+// (name, declaration) pair is already present" is O(1) instead of a scan of
+// the whole vector. The vector stays the result and keeps first-seen order.
+// Both texts are interned, so the index holds one 64-bit key per entry and a
+// duplicate is rejected without building any std::string.
+class FunctionTable {
+public:
+    // Indexes whatever `functions` already contains. Texts are interned in
+    // `strings`, or in a private interner when none is given.
+    explicit FunctionTable(std::vector<FunctionInfo>& functions, StringInterner* strings = nullptr);
+
+    // Returns false if the pair was already in the table.
+    bool add(std::string_view function_name, std::string_view declaration_text);
+
+private:
+    uint64_t key(std::string_view function_name, std::string_view declaration_text);
+
+    std::vector<FunctionInfo>& functions_;
+    std::unique_ptr<StringInterner> own_strings_;
+    StringInterner* strings_;
+    std::unordered_set<uint64_t> index_; // name id << 32 | declaration id
+};
+
+// Collects every function declared or defined in the tree, in source order,
+// skipping exact (name, declaration) duplicates.
+class FunctionChecker : public Checker {
+public:
+    explicit FunctionChecker(std::vector<FunctionInfo>& functions, StringInterner* strings = nullptr)
+        : functions_(functions, strings) {}
+
+    std::vector<TSSymbol> subscriptions(const CppGrammar &g) const override;
+    std::string_view query() const override;
+    void begin(std::string_view code) override { code_ = code; }
+    Visit match(const QueryMatch &match) override;
+
+private:
+    FunctionTable functions_;
+    std::string_view code_;
+    std::string declaration_; // scratch for a definition's declaration text
+};
+
+// Collects every function declared or defined under `node`, in source order,
+// skipping exact (name, declaration) duplicates.
+void collect_functions(TSNode node, std::string_view code, std::vector<FunctionInfo>& functions);
+
+// Print the collected functions in a table-like format
+void print_function_table(const std::vector<FunctionInfo>& functions);
@@ -0,0 +1,102 @@
+#include "grammar.h"
+
+CppGrammar::CppGrammar(const TSLanguage *language)
+    : language(language), symbol_count(ts_language_symbol_count(language)) {
+    identifier = symbol("identifier");
+    field_identifier = symbol("field_identifier");
+    destructor_name = symbol("destructor_name");
+    primitive_type = symbol("primitive_type");
+    init_declarator = symbol("init_declarator");
+    pointer_declarator = symbol("pointer_declarator");
+    reference_declarator = symbol("reference_declarator");
+    function_declarator = symbol("function_declarator");
+    function_definition = symbol("function_definition");
+    function_declaration = symbol("function_declaration");
+    field_declaration = symbol("field_declaration");
+    call_expression = symbol("call_expression");
+    argument_list = symbol("argument_list");
+    new_expression = symbol("new_expression");
+    delete_expression = symbol("delete_expression");
+    assignment_expression = symbol("assignment_expression");
+    subscript_expression = symbol("subscript_expression");
+    field_expression = symbol("field_expression");
+    return_statement = symbol("return_statement");
+    if_statement = symbol("if_statement");
+    number_literal = symbol("number_literal");
+    binary_expression = symbol("binary_expression");
+    parenthesized_expression = symbol("parenthesized_expression");
+    unary_expression = symbol("unary_expression");
+    conditional_expression = symbol("conditional_expression");
+    comma_expression = symbol("comma_expression");
+    sizeof_expression = symbol("sizeof_expression");
+    cast_expression = symbol("cast_expression");
+    type_descriptor = symbol("type_descriptor");
+    condition_clause = symbol("condition_clause");
+    char_literal = symbol("char_literal");
+    true_literal = symbol("true");
+    false_literal = symbol("false");
+    declaration = symbol("declaration");
+    update_expression = symbol("update_expression");
+    pointer_expression = symbol("pointer_expression");
+    lambda_expression = symbol("lambda_expression");
+    array_declarator = symbol("array_declarator");
+    type_qualifier = symbol("type_qualifier");
+    storage_class_specifier = symbol("storage_class_specifier");
+    class_specifier = symbol("class_specifier");
+    struct_specifier = symbol("struct_specifier");
+    union_specifier = symbol("union_specifier");
+    qualified_identifier = symbol("qualified_identifier");
+    template_function = symbol("template_function");
+    this_expression = symbol("this");
+    namespace_definition = symbol("namespace_definition");
+    declaration_list = symbol("declaration_list");
+    compound_statement = symbol("compound_statement");
+    expression_statement = symbol("expression_statement");
+    while_statement = symbol("while_statement");
+    for_statement = symbol("for_statement");
+    for_range_loop = symbol("for_range_loop");
+    do_statement = symbol("do_statement");
+    switch_statement = symbol("switch_statement");
+    case_statement = symbol("case_statement");
+    break_statement = symbol("break_statement");
+    continue_statement = symbol("continue_statement");
+    goto_statement = symbol("goto_statement");
+    labeled_statement = symbol("labeled_statement");
+    try_statement = symbol("try_statement");
+    catch_clause = symbol("catch_clause");
+    else_clause = symbol("else_clause");
+    comment = symbol("comment");
+
+    field_declarator = field("declarator");
+    field_value = field("value");
+    field_function = field("function");
+    field_arguments = field("arguments");
+    field_left = field("left");
+    field_right = field("right");
+    field_condition = field("condition");
+    field_consequence = field("consequence");
+    field_alternative = field("alternative");
+    field_body = field("body");
+    field_initializer = field("initializer");
+    field_update = field("update");
+    field_label = field("label");
+    field_operator = field("operator");
+    field_type = field("type");
+    field_argument = field("argument");
+    field_parameters = field("parameters");
+    field_name = field("name");
+    field_field = field("field");
+}
+
+TSSymbol CppGrammar::symbol(const char *name, bool named) const {
+    return ts_language_symbol_for_name(language, name, static_cast<uint32_t>(strlen(name)), named);
+}
+
+TSFieldId CppGrammar::field(const char *name) const {
+    return ts_language_field_id_for_name(language, name, static_cast<uint32_t>(strlen(name)));
+}
+
+const CppGrammar &cpp_grammar() {
+    static const CppGrammar grammar(tree_sitter_cpp());
+    return grammar;
+}
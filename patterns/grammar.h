@@ -0,0 +1,125 @@
+#pragma once
+#include "common.h"
+
+// Node kinds and field ids of the C++ grammar, resolved once per process with
+// ts_language_symbol_for_name / ts_language_field_id_for_name. Comparing a
+// TSSymbol is a single integer compare, whereas ts_node_type() plus a string
+// compare costs a strlen and (when wrapped in std::string) an allocation per
+// node. A name missing from the grammar resolves to 0, which no visited node
+// carries, so handlers registered for it simply never fire.
+struct CppGrammar {
+    const TSLanguage *language;
+    uint32_t symbol_count;
+
+    TSSymbol identifier;
+    TSSymbol field_identifier;
+    TSSymbol destructor_name;
+    TSSymbol primitive_type;
+    TSSymbol init_declarator;
+    TSSymbol pointer_declarator;
+    TSSymbol reference_declarator;
+    TSSymbol function_declarator;
+    TSSymbol function_definition;
+    TSSymbol function_declaration;
+    TSSymbol field_declaration;
+    TSSymbol call_expression;
+    TSSymbol argument_list;
+    TSSymbol new_expression;
+    TSSymbol delete_expression;
+    TSSymbol assignment_expression;
+    TSSymbol subscript_expression;
+    TSSymbol field_expression;
+    TSSymbol return_statement;
+    TSSymbol if_statement;
+    TSSymbol number_literal;
+    TSSymbol binary_expression;
+    TSSymbol parenthesized_expression;
+    TSSymbol unary_expression;
+    TSSymbol conditional_expression;
+    TSSymbol comma_expression;
+    TSSymbol sizeof_expression;
+    TSSymbol cast_expression;
+    TSSymbol type_descriptor;
+    TSSymbol condition_clause;
+    TSSymbol char_literal;
+    TSSymbol true_literal;
+    TSSymbol false_literal;
+    TSSymbol declaration;
+    TSSymbol update_expression;
+    TSSymbol pointer_expression;
+    TSSymbol lambda_expression;
+    TSSymbol array_declarator;
+    TSSymbol type_qualifier;
+    TSSymbol storage_class_specifier;
+    TSSymbol class_specifier;
+    TSSymbol struct_specifier;
+    TSSymbol union_specifier;
+    TSSymbol qualified_identifier;
+    TSSymbol template_function;
+    TSSymbol this_expression;
+    TSSymbol namespace_definition;
+    TSSymbol declaration_list;
+    TSSymbol compound_statement;
+    TSSymbol expression_statement;
+    TSSymbol while_statement;
+    TSSymbol for_statement;
+    TSSymbol for_range_loop;
+    TSSymbol do_statement;
+    TSSymbol switch_statement;
+    TSSymbol case_statement;
+    TSSymbol break_statement;
+    TSSymbol continue_statement;
+    TSSymbol goto_statement;
+    TSSymbol labeled_statement;
+    TSSymbol try_statement;
+    TSSymbol catch_clause;
+    TSSymbol else_clause;
+    TSSymbol comment;
+
+    TSFieldId field_declarator;
+    TSFieldId field_value;
+    TSFieldId field_function;
+    TSFieldId field_arguments;
+    TSFieldId field_left;
+    TSFieldId field_right;
+    TSFieldId field_condition;
+    TSFieldId field_consequence;
+    TSFieldId field_alternative;
+    TSFieldId field_body;
+    TSFieldId field_initializer;
+    TSFieldId field_update;
+    TSFieldId field_label;
+    TSFieldId field_operator;
+    TSFieldId field_type;
+    TSFieldId field_argument;
+    TSFieldId field_parameters;
+    TSFieldId field_name;
+    TSFieldId field_field;
+
+    explicit CppGrammar(const TSLanguage *language);
+
+    TSSymbol symbol(const char *name, bool named = true) const;
+    TSFieldId field(const char *name) const;
+};
+
+// The process-wide grammar table for tree_sitter_cpp(); initialised on first use.
+const CppGrammar &cpp_grammar();
+
+// Dispatch table from node symbol to handler. Lookups are a bounds check and
+// an index; symbols outside the language (the ERROR symbol is 0xFFFF) map to
+// the empty handler.
+template <typename Handler>
+class SymbolTable {
+public:
+    explicit SymbolTable(uint32_t symbol_count) : handlers_(symbol_count) {}
+
+    void set(TSSymbol symbol, Handler handler) {
+        if (symbol != 0 && symbol < handlers_.size()) handlers_[symbol] = handler;
+    }
+    Handler get(TSSymbol symbol) const {
+        return symbol < handlers_.size() ? handlers_[symbol] : Handler{};
+    }
+
+private:
+    std::vector<Handler> handlers_;
+};
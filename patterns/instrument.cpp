@@ -0,0 +1,110 @@
+#include "instrument.h"
+#include "json.h"
+#include <cstdlib>
+#include <tree_sitter/api.h>
+
+const char *const phase_names[phase_count] = {"read", "parse", "walk", "check", "report"};
+
+static thread_local Metrics *thread_metrics = nullptr;
+static thread_local uint64_t thread_allocation_count = 0;
+
+void Metrics::add(const Metrics &other) {
+    for (int p = 0; p < phase_count; p++) nanos[p] += other.nanos[p];
+    nodes += other.nodes;
+    bytes += other.bytes;
+    allocations += other.allocations;
+}
+
+Metrics *current_metrics() {
+    return thread_metrics;
+}
+
+void set_current_metrics(Metrics *metrics) {
+    thread_metrics = metrics;
+}
+
+uint64_t thread_allocations() {
+    return thread_allocation_count;
+}
+
+void note_allocation() {
+    thread_allocation_count++;
+}
+
+static void *counting_malloc(size_t size) {
+    thread_allocation_count++;
+    return malloc(size);
+}
+
+static void *counting_calloc(size_t count, size_t size) {
+    thread_allocation_count++;
+    return calloc(count, size);
+}
+
+static void *counting_realloc(void *ptr, size_t size) {
+    thread_allocation_count++;
+    return realloc(ptr, size);
+}
+
+void count_tree_sitter_allocations() {
+    ts_set_allocator(counting_malloc, counting_calloc, counting_realloc, free);
+}
+
+MetricsScope::MetricsScope(Metrics *metrics)
+    : metrics_(metrics), previous_(thread_metrics), allocations_(thread_allocation_count) {
+    if (metrics_) thread_metrics = metrics_;
+}
+
+MetricsScope::~MetricsScope() {
+    if (!metrics_) return;
+    metrics_->allocations += thread_allocation_count - allocations_;
+    thread_metrics = previous_;
+}
+
+static void write_json_metrics(std::ostream &out, const Metrics &m) {
+    for (int p = 0; p < phase_count; p++) out << '"' << phase_names[p] << "_ns\": " << m.nanos[p] << ", ";
+    out << "\"nodes\": " << m.nodes << ", \"bytes\": " << m.bytes << ", \"allocations\": " << m.allocations;
+}
+
+void write_metrics_json(std::ostream &out, const std::vector<std::string> &paths,
+                        const std::vector<Metrics> &metrics, uint64_t wall_nanos) {
+    Metrics total;
+    size_t hits = 0;
+    out << "{\n  \"files\": [\n";
+    for (size_t i = 0; i < metrics.size(); i++) {
+        total.add(metrics[i]);
+        hits += metrics[i].cache_hit;
+        out << "    {\"path\": ";
+        write_json_string(out, paths[i]);
+        out << ", \"cache_hit\": " << (metrics[i].cache_hit ? "true" : "false") << ", ";
+        write_json_metrics(out, metrics[i]);
+        out << (i + 1 < metrics.size() ? "},\n" : "}\n");
+    }
+    out << "  ],\n  \"total\": {\"files\": " << metrics.size() << ", \"cache_hits\": " << hits << ", \"wall_ns\": " << wall_nanos << ", ";
+    write_json_metrics(out, total);
+    out << "}\n}\n";
+}
+
+void write_metrics_csv(std::ostream &out, const std::vector<std::string> &paths,
+                       const std::vector<Metrics> &metrics, uint64_t wall_nanos) {
+    out << "path,cache_hit";
+    for (int p = 0; p < phase_count; p++) out << ',' << phase_names[p] << "_ns";
+    out << ",nodes,bytes,allocations\n";
+    auto row = [&](const std::string &path, const Metrics &m, const std::string &hit) {
+        // Quote the path; embedded quotes are doubled.
+        out << '"';
+        for (char c : path) out << (c == '"' ? "\"\"" : std::string(1, c));
+        out << "\"," << hit;
+        for (int p = 0; p < phase_count; p++) out << ',' << m.nanos[p];
+        out << ',' << m.nodes << ',' << m.bytes << ',' << m.allocations << '\n';
+    };
+    Metrics total;
+    size_t hits = 0;
+    for (size_t i = 0; i < metrics.size(); i++) {
+        total.add(metrics[i]);
+        hits += metrics[i].cache_hit;
+        row(paths[i], metrics[i], metrics[i].cache_hit ? "1" : "0");
+    }
+    // The aggregate row reports the run's wall time in place of a path.
+    row("TOTAL wall_ns=" + std::to_string(wall_nanos), total, std::to_string(hits));
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Per-file instrumentation: wall time per phase plus volume counters. The code
+// being measured only ever asks current_metrics() for the calling thread's
+// Metrics; when instrumentation is off that pointer is null and every probe
+// reduces to one thread-local load and a branch.
+
+enum Phase {
+    phase_read,
+    phase_parse,
+    phase_walk,   // traversal itself, excluding checker callbacks
+    phase_check,  // checker callbacks and summaries
+    phase_report,
+    phase_count
+};
+
+extern const char *const phase_names[phase_count];
+
+struct Metrics {
+    uint64_t nanos[phase_count] = {};
+    uint64_t nodes = 0;        // nodes visited by checker pipelines
+    uint64_t bytes = 0;        // source bytes analyzed
+    uint64_t allocations = 0;  // operator new + tree-sitter allocations, when counted
+    bool cache_hit = false;
+
+    void add(const Metrics &other);
+};
+
+inline uint64_t monotonic_nanos() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Metrics the calling thread is currently recording into, or null.
+Metrics *current_metrics();
+void set_current_metrics(Metrics *metrics);
+
+// Allocations made by the calling thread so far. Only counts when the program
+// links patterns/alloc_counter.cpp (operator new) or called
+// count_tree_sitter_allocations(); otherwise it stays 0.
+uint64_t thread_allocations();
+void note_allocation();
+
+// Routes tree-sitter's allocator through counting wrappers around malloc.
+// Call once, before any parser exists.
+void count_tree_sitter_allocations();
+
+// Records into `metrics` on the calling thread for the lifetime of the scope,
+// attributing allocations made meanwhile. Does nothing if `metrics` is null.
+class MetricsScope {
+public:
+    explicit MetricsScope(Metrics *metrics);
+    ~MetricsScope();
+    MetricsScope(const MetricsScope &) = delete;
+    MetricsScope &operator=(const MetricsScope &) = delete;
+
+private:
+    Metrics *metrics_;
+    Metrics *previous_;
+    uint64_t allocations_;
+};
+
+// Adds the time until destruction to `phase` of the current metrics, if any.
+class PhaseTimer {
+public:
+    explicit PhaseTimer(Phase phase) : metrics_(current_metrics()), phase_(phase), start_(metrics_ ? monotonic_nanos() : 0) {}
+    ~PhaseTimer() {
+        if (metrics_) metrics_->nanos[phase_] += monotonic_nanos() - start_;
+    }
+    PhaseTimer(const PhaseTimer &) = delete;
+    PhaseTimer &operator=(const PhaseTimer &) = delete;
+
+private:
+    Metrics *metrics_;
+    Phase phase_;
+    uint64_t start_;
+};
+
+// Machine-readable summaries: one row/object per file plus the aggregate.
+void write_metrics_json(std::ostream &out, const std::vector<std::string> &paths,
+                        const std::vector<Metrics> &metrics, uint64_t wall_nanos);
+void write_metrics_csv(std::ostream &out, const std::vector<std::string> &paths,
+                       const std::vector<Metrics> &metrics, uint64_t wall_nanos);
@@ -0,0 +1,81 @@
+#include "interner.h"
+
+static const size_t chunk_size = 64 * 1024;
+
+static uint32_t hash_text(std::string_view text) {
+    // FNV-1a: identifiers are short, so a byte loop beats anything wider.
+    uint32_t hash = 2166136261u;
+    for (unsigned char c : text) hash = (hash ^ c) * 16777619u;
+    return hash;
+}
+
+StringInterner::StringInterner() : slots_(256, Slot{0, none}) {}
+
+const char *StringInterner::store(std::string_view text) {
+    if (text.empty()) return "";
+    // Long strings get a chunk of their own so they do not waste the rest of
+    // the current one.
+    if (text.size() > chunk_size / 4) {
+        large_.emplace_back(new char[text.size()]);
+        memcpy(large_.back().get(), text.data(), text.size());
+        return large_.back().get();
+    }
+    if (text.size() > free_size_) {
+        chunks_.emplace_back(new char[chunk_size]);
+        free_ = chunks_.back().get();
+        free_size_ = chunk_size;
+    }
+    char *stored = free_;
+    memcpy(stored, text.data(), text.size());
+    free_ += text.size();
+    free_size_ -= text.size();
+    return stored;
+}
+
+void StringInterner::rehash(size_t slot_count) {
+    std::vector<Slot> slots(slot_count, Slot{0, none});
+    size_t mask = slot_count - 1;
+    for (const Slot &slot : slots_) {
+        if (slot.id == none) continue;
+        size_t i = slot.hash & mask;
+        while (slots[i].id != none) i = (i + 1) & mask;
+        slots[i] = slot;
+    }
+    slots_.swap(slots);
+}
+
+uint32_t StringInterner::find(std::string_view text) const {
+    uint32_t hash = hash_text(text);
+    size_t mask = slots_.size() - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        const Slot &slot = slots_[i];
+        if (slot.id == none) return none;
+        if (slot.hash == hash && strings_[slot.id] == text) return slot.id;
+    }
+}
+
+uint32_t StringInterner::intern(std::string_view text) {
+    uint32_t hash = hash_text(text);
+    size_t mask = slots_.size() - 1;
+    size_t i = hash & mask;
+    for (; slots_[i].id != none; i = (i + 1) & mask) {
+        if (slots_[i].hash == hash && strings_[slots_[i].id] == text) return slots_[i].id;
+    }
+    uint32_t id = size();
+    strings_.emplace_back(store(text), text.size());
+    bytes_ += text.size();
+    slots_[i] = Slot{hash, id};
+    // Keep the table at most half full so probe runs stay short.
+    if (strings_.size() * 2 > slots_.size()) rehash(slots_.size() * 2);
+    return id;
+}
+
+void StringInterner::clear() {
+    std::fill(slots_.begin(), slots_.end(), Slot{0, none});
+    strings_.clear();
+    large_.clear();
+    if (chunks_.size() > 1) chunks_.resize(1);
+    free_ = chunks_.empty() ? nullptr : chunks_[0].get();
+    free_size_ = chunks_.empty() ? 0 : chunk_size;
+    bytes_ = 0;
+}
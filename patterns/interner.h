@@ -0,0 +1,54 @@
+#pragma once
+#include "common.h"
+#include <memory>
+
+// Maps strings to dense 32-bit ids (0, 1, 2, ... in first-seen order) so that
+// analyses can key their tables on integers: a name is hashed once when it is
+// interned, and every later lookup is an array index. Texts are copied into an
+// arena of large chunks, so views returned by view() stay valid until clear()
+// and interning allocates only when a chunk fills up.
+//
+// Not thread-safe; each session (or single analyze_code run) owns one.
+class StringInterner {
+public:
+    static const uint32_t none = UINT32_MAX;
+
+    StringInterner();
+    StringInterner(const StringInterner &) = delete;
+    StringInterner &operator=(const StringInterner &) = delete;
+
+    // Id of `text`, adding it if it is new.
+    uint32_t intern(std::string_view text);
+
+    // Id of `text`, or `none` if it was never interned.
+    uint32_t find(std::string_view text) const;
+
+    std::string_view view(uint32_t id) const { return strings_[id]; }
+
+    // Number of distinct strings, which is also one past the largest id.
+    uint32_t size() const { return static_cast<uint32_t>(strings_.size()); }
+
+    // Arena bytes holding string text.
+    size_t bytes() const { return bytes_; }
+
+    // Forgets every string; ids are reused from 0 and old views dangle. The
+    // first arena chunk is kept for reuse.
+    void clear();
+
+private:
+    struct Slot {
+        uint32_t hash;
+        uint32_t id; // `none` when empty
+    };
+
+    const char *store(std::string_view text);
+    void rehash(size_t slot_count);
+
+    std::vector<Slot> slots_; // open addressing, linear probing, power-of-two size
+    std::vector<std::string_view> strings_;
+    std::vector<std::unique_ptr<char[]>> chunks_; // all chunk_size bytes
+    std::vector<std::unique_ptr<char[]>> large_;  // one oversized string each
+    char *free_ = nullptr;
+    size_t free_size_ = 0;
+    size_t bytes_ = 0;
+};
@@ -0,0 +1,183 @@
+#include "json.h"
+#include <cstdlib>
+#include <stdexcept>
+
+void write_json_string(std::ostream &out, std::string_view value) {
+    out << '"';
+    for (char c : value) {
+        switch (c) {
+            case '"': out << "\\\""; break;
+            case '\\': out << "\\\\"; break;
+            case '\n': out << "\\n"; break;
+            case '\t': out << "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    const char *digits = "0123456789abcdef";
+                    out << "\\u00" << digits[(c >> 4) & 15] << digits[c & 15];
+                } else {
+                    out << c;
+                }
+        }
+    }
+    out << '"';
+}
+
+namespace {
+
+class Reader {
+public:
+    explicit Reader(std::string_view text) : text_(text) {}
+
+    JsonObject object() {
+        JsonObject result;
+        expect('{');
+        if (peek() == '}') {
+            pos_++;
+            return end(result);
+        }
+        for (;;) {
+            if (peek() != '"') fail("expected a member name");
+            std::string name = string();
+            expect(':');
+            result[name] = value();
+            char c = peek();
+            pos_++;
+            if (c == '}') return end(result);
+            if (c != ',') fail("expected ',' or '}'");
+        }
+    }
+
+private:
+    [[noreturn]] void fail(const char *what) const {
+        throw std::runtime_error("Error: invalid JSON at offset " + std::to_string(pos_) + ": " + what);
+    }
+
+    char peek() {
+        while (pos_ < text_.size() && (text_[pos_] == ' ' || text_[pos_] == '\t' ||
+                                       text_[pos_] == '\r' || text_[pos_] == '\n')) {
+            pos_++;
+        }
+        return pos_ < text_.size() ? text_[pos_] : '\0';
+    }
+
+    void expect(char c) {
+        if (peek() != c) fail(c == '{' ? "expected an object" : c == ':' ? "expected ':'" : "unexpected character");
+        pos_++;
+    }
+
+    JsonObject &end(JsonObject &result) {
+        if (peek() != '\0') fail("trailing characters after the object");
+        return result;
+    }
+
+    JsonValue value() {
+        JsonValue v;
+        char c = peek();
+        if (c == '"') {
+            v.type = JsonValue::String;
+            v.string = string();
+        } else if (c == '{' || c == '[') {
+            fail("nested objects and arrays are not supported");
+        } else if (literal("true")) {
+            v.type = JsonValue::Bool;
+            v.boolean = true;
+        } else if (literal("false")) {
+            v.type = JsonValue::Bool;
+        } else if (literal("null")) {
+            v.type = JsonValue::Null;
+        } else {
+            size_t start = pos_;
+            while (pos_ < text_.size() && std::string_view("+-.0123456789eE").find(text_[pos_]) != std::string_view::npos) {
+                pos_++;
+            }
+            std::string number(text_.substr(start, pos_ - start));
+            char *parsed_end = nullptr;
+            v.type = JsonValue::Number;
+            v.number = std::strtod(number.c_str(), &parsed_end);
+            if (number.empty() || *parsed_end != '\0') fail("expected a value");
+        }
+        return v;
+    }
+
+    bool literal(std::string_view word) {
+        if (text_.substr(pos_, word.size()) != word) return false;
+        pos_ += word.size();
+        return true;
+    }
+
+    unsigned hex4() {
+        if (pos_ + 4 > text_.size()) fail("truncated \\u escape");
+        unsigned code = 0;
+        for (int i = 0; i < 4; i++) {
+            char c = text_[pos_++];
+            code <<= 4;
+            if (c >= '0' && c <= '9') code |= c - '0';
+            else if (c >= 'a' && c <= 'f') code |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') code |= c - 'A' + 10;
+            else fail("bad \\u escape");
+        }
+        return code;
+    }
+
+    static void append_utf8(std::string &out, unsigned code) {
+        if (code < 0x80) {
+            out += static_cast<char>(code);
+        } else if (code < 0x800) {
+            out += static_cast<char>(0xc0 | (code >> 6));
+            out += static_cast<char>(0x80 | (code & 0x3f));
+        } else if (code < 0x10000) {
+            out += static_cast<char>(0xe0 | (code >> 12));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+            out += static_cast<char>(0x80 | (code & 0x3f));
+        } else {
+            out += static_cast<char>(0xf0 | (code >> 18));
+            out += static_cast<char>(0x80 | ((code >> 12) & 0x3f));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+            out += static_cast<char>(0x80 | (code & 0x3f));
+        }
+    }
+
+    std::string string() {
+        pos_++; // opening quote
+        std::string out;
+        for (;;) {
+            // Copy the run up to the next quote or escape in one go.
+            size_t stop = text_.find_first_of("\"\\", pos_);
+            if (stop == std::string_view::npos) fail("unterminated string");
+            out.append(text_.substr(pos_, stop - pos_));
+            pos_ = stop + 1;
+            if (text_[stop] == '"') return out;
+            if (pos_ >= text_.size()) fail("unterminated string");
+            char c = text_[pos_++];
+            switch (c) {
+                case '"': case '\\': case '/': out += c; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u': {
+                    unsigned code = hex4();
+                    if (code >= 0xd800 && code < 0xdc00 && text_.substr(pos_, 2) == "\\u") {
+                        pos_ += 2;
+                        unsigned low = hex4();
+                        if (low < 0xdc00 || low > 0xdfff) fail("unpaired surrogate");
+                        code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                    }
+                    append_utf8(out, code);
+                    break;
+                }
+                default: fail("bad escape");
+            }
+        }
+    }
+
+    std::string_view text_;
+    size_t pos_ = 0;
+};
+
+} // namespace
+
+JsonObject parse_json_object(std::string_view text) {
+    return Reader(text).object();
+}
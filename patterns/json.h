@@ -0,0 +1,24 @@
+#pragma once
+#include <map>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+// Just enough JSON for the line protocols and machine-readable reports: writing
+// escaped strings, and reading one flat object whose values are strings,
+// numbers, booleans or null.
+
+struct JsonValue {
+    enum Type { Null, Bool, Number, String } type = Null;
+    std::string string;   // String
+    double number = 0;    // Number
+    bool boolean = false; // Bool
+};
+
+using JsonObject = std::map<std::string, JsonValue, std::less<>>;
+
+void write_json_string(std::ostream &out, std::string_view value);
+
+// Parses `text` as a single flat object. Nested objects and arrays are
+// rejected. Throws std::runtime_error describing the first problem.
+JsonObject parse_json_object(std::string_view text);
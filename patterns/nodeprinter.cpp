@@ -1,17 +1,18 @@
-#include "common.h"
-void print_node(TSNode node, const std::string &source, int indent = 0) {
-    // Print the current node's information.
-    std::string prefix(indent, ' ');
-    std::cout << prefix << "\\-- " << ts_node_type(node) << " (`";
-    uint32_t start_byte = ts_node_start_byte(node);
-    uint32_t end_byte = ts_node_end_byte(node);
-    std::cout << source.substr(start_byte, end_byte - start_byte) << "`)" << std::endl;
-    uint32_t child_count = ts_node_child_count(node);
-
-    // Recursively print each child.
-    for (uint32_t i = 0; i < child_count; i++) {
-        TSNode child = ts_node_child(node, i);
-        print_node(child, source, indent + 2);
-    }
-
-}
\ No newline at end of file
+#include "nodeprinter.h"
+#include "visitor.h"
+void print_node(TSNode node, std::string_view source, int indent, std::ostream &out) {
+    // Print every node of the subtree, two extra spaces per level. The
+    // indentation is cut from one buffer that only grows, so deep trees do not
+    // allocate a string per line.
+    std::string padding;
+    TreeWalker walker;
+    walker.walk(node, [&](TSNode current, uint32_t depth) {
+        size_t width = indent + 2 * size_t(depth);
+        if (padding.size() < width) padding.resize(std::max(width, padding.size() * 2), ' ');
+        out.write(padding.data(), static_cast<std::streamsize>(width));
+        out << "\\-- " << ts_node_type(current) << " (`";
+        out << node_text(current, source) << "`)\n";
+        return Visit::Continue;
+    });
+    out.flush();
+}
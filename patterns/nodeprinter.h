@@ -0,0 +1,6 @@
+#pragma once
+#include "common.h"
+
+// Dumps the subtree under `node` to `out`, one line per node with its type and
+// source text, indented two spaces per level below `indent`.
+void print_node(TSNode node, std::string_view source, int indent = 0, std::ostream &out = std::cout);
@@ -0,0 +1,42 @@
+#include "parser_pool.h"
+
+static TSParser *new_cpp_parser() {
+    TSParser *parser = ts_parser_new();
+    ts_parser_set_language(parser, tree_sitter_cpp());
+    return parser;
+}
+
+ParserPool::ParserPool(size_t reserve) {
+    for (size_t i = 0; i < reserve; i++) idle_.push_back(new_cpp_parser());
+    created_ = reserve;
+}
+
+ParserPool::~ParserPool() {
+    // Leases must not outlive the pool, so every parser is idle by now.
+    for (TSParser *parser : idle_) ts_parser_delete(parser);
+}
+
+ParserPool::Lease ParserPool::acquire() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!idle_.empty()) {
+            TSParser *parser = idle_.back();
+            idle_.pop_back();
+            return Lease(*this, parser);
+        }
+        created_++;
+    }
+    return Lease(*this, new_cpp_parser());
+}
+
+size_t ParserPool::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return created_;
+}
+
+void ParserPool::release(TSParser *parser) {
+    // Drops any state a halted or failed parse left behind.
+    ts_parser_reset(parser);
+    std::lock_guard<std::mutex> lock(mutex_);
+    idle_.push_back(parser);
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "common.h"
+#include <mutex>
+
+// Thread-safe pool of TSParsers with the C++ language already set. Creating a
+// parser and loading the language is the expensive part of a small parse, so
+// long-lived callers borrow one per request instead of making their own.
+// Parsers are created on demand and kept until the pool is destroyed, so the
+// pool grows to the highest number of parses that ran at once.
+class ParserPool {
+public:
+    // A borrowed parser, returned to the pool when the lease goes away.
+    class Lease {
+    public:
+        Lease(ParserPool &pool, TSParser *parser) : pool_(&pool), parser_(parser) {}
+        Lease(Lease &&other) noexcept : pool_(other.pool_), parser_(other.parser_) { other.parser_ = nullptr; }
+        Lease(const Lease &) = delete;
+        Lease &operator=(const Lease &) = delete;
+        Lease &operator=(Lease &&) = delete;
+        ~Lease() {
+            if (parser_) pool_->release(parser_);
+        }
+        TSParser *get() const { return parser_; }
+        operator TSParser *() const { return parser_; }
+
+    private:
+        ParserPool *pool_;
+        TSParser *parser_;
+    };
+
+    // Creates `reserve` parsers up front.
+    explicit ParserPool(size_t reserve = 0);
+    ~ParserPool();
+    ParserPool(const ParserPool &) = delete;
+    ParserPool &operator=(const ParserPool &) = delete;
+
+    Lease acquire();
+
+    // Parsers created so far, idle or leased.
+    size_t size() const;
+
+private:
+    void release(TSParser *parser);
+
+    mutable std::mutex mutex_;
+    std::vector<TSParser *> idle_;
+    size_t created_ = 0;
+};
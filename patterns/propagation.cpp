@@ -0,0 +1,349 @@
+#include "propagation.h"
+#include "grammar.h"
+#include "visitor.h"
+
+void ConstantEnvironment::add(std::string_view name, uint32_t start, uint32_t end, const ConstantValue &value) {
+    if (start >= end) return;
+    std::vector<Segment> &list = segments_[name];
+    auto at = std::upper_bound(list.begin(), list.end(), start,
+                               [](uint32_t byte, const Segment &segment) { return byte < segment.start; });
+    list.insert(at, {start, end, value});
+}
+
+bool ConstantEnvironment::lookup(std::string_view name, uint32_t byte, ConstantValue &value) const {
+    auto found = segments_.find(name);
+    if (found == segments_.end()) return false;
+    const std::vector<Segment> &list = found->second;
+    auto at = std::upper_bound(list.begin(), list.end(), byte,
+                               [](uint32_t position, const Segment &segment) { return position < segment.start; });
+    while (at != list.begin()) {
+        --at;
+        if (at->end > byte) {
+            value = at->value;
+            return true;
+        }
+    }
+    return false;
+}
+
+// The identifier a declarator declares, through pointer, reference, array,
+// function and init declarators; null for anything else.
+static TSNode declared_name(TSNode declarator) {
+    const CppGrammar &g = cpp_grammar();
+    while (!ts_node_is_null(declarator)) {
+        TSSymbol symbol = ts_node_symbol(declarator);
+        if (symbol == g.identifier) return declarator;
+        if (symbol == g.reference_declarator) {
+            declarator = ts_node_named_child(declarator, 0);
+        } else if (symbol == g.init_declarator || symbol == g.pointer_declarator || symbol == g.array_declarator ||
+                   symbol == g.function_declarator) {
+            declarator = ts_node_child_by_field_id(declarator, g.field_declarator);
+        } else {
+            break;
+        }
+    }
+    return TSNode{};
+}
+
+// The parameter list of a function or lambda declarator, through any pointer
+// or reference declarators wrapped around it; null if there is none.
+static TSNode parameters_of(TSNode declarator) {
+    const CppGrammar &g = cpp_grammar();
+    while (!ts_node_is_null(declarator)) {
+        TSNode parameters = ts_node_child_by_field_id(declarator, g.field_parameters);
+        if (!ts_node_is_null(parameters)) return parameters;
+        declarator = ts_node_symbol(declarator) == g.reference_declarator ? ts_node_named_child(declarator, 0)
+                                                                         : ts_node_child_by_field_id(declarator, g.field_declarator);
+    }
+    return TSNode{};
+}
+
+// One walk over a function body. The first pass (evaluate = false) records,
+// for every write, where the variable stops being reliable; the second folds
+// declarations and statement-level writes in source order against what has
+// been recorded so far. Both see the same declarations in the same order, so
+// a declaration's ordinal identifies it across passes.
+class ConstantEnvironment::Builder {
+public:
+    Builder(ConstantEnvironment &environment, std::string_view code, bool evaluate, std::vector<bool> &unstable,
+            bool &has_goto)
+        : environment_(environment), code_(code), evaluate_(evaluate), unstable_(unstable), has_goto_(has_goto),
+          evaluator_(code) {
+        evaluator_.set_environment(&environment);
+    }
+
+    void run(TSNode function, TSNode body);
+
+private:
+    struct Declared {
+        std::string_view name;
+        std::string_view type;
+        uint32_t scope;   // index into scopes_
+        uint32_t ordinal; // position among all declarations of the function
+        bool tracked;     // an integer variable whose writes are followed
+        bool immutable;   // const or constexpr
+    };
+
+    struct Scope {
+        const void *id;
+        uint32_t start;
+        uint32_t end;
+        size_t declared; // declared_ size when the scope opened
+        bool loop;       // may run more than once: a loop, lambda or local function
+    };
+
+    void open_scope(TSNode node, bool loop);
+    void close_scope();
+    const Declared &declare(TSNode name, std::string_view type, bool tracked, bool immutable);
+    void declare_parameters(TSNode parameters);
+    void on_declaration(TSNode declaration);
+    void on_write(TSNode target, TSNode write, uint32_t depth);
+    void on_escape(TSNode target);
+    bool by_reference(uint32_t depth) const;
+    const Declared *resolve(TSNode identifier) const;
+    ConstantValue convert(const ConstantValue &value, std::string_view type) const;
+    bool integral(std::string_view type) const;
+    bool unstable(const Declared &declared) const {
+        return !declared.immutable && (has_goto_ || unstable_[declared.ordinal]);
+    }
+
+    ConstantEnvironment &environment_;
+    std::string_view code_;
+    bool evaluate_;
+    std::vector<bool> &unstable_;
+    bool &has_goto_;
+    ConstantEvaluator evaluator_;
+    TreeWalker walker_;
+    std::vector<TSNode> path_; // ancestors of the current node, by depth
+    std::vector<Scope> scopes_;
+    std::vector<uint32_t> loops_; // indices of the loop scopes, innermost last
+    std::vector<Declared> declared_;
+    std::unordered_map<std::string_view, std::vector<uint32_t>> visible_; // name -> declared_ indices
+    uint32_t ordinal_ = 0;
+};
+
+void ConstantEnvironment::Builder::open_scope(TSNode node, bool loop) {
+    if (loop) loops_.push_back(static_cast<uint32_t>(scopes_.size()));
+    scopes_.push_back({node.id, ts_node_start_byte(node), ts_node_end_byte(node), declared_.size(), loop});
+}
+
+void ConstantEnvironment::Builder::close_scope() {
+    const Scope &scope = scopes_.back();
+    for (size_t i = scope.declared; i < declared_.size(); i++) visible_[declared_[i].name].pop_back();
+    declared_.resize(scope.declared);
+    if (scope.loop) loops_.pop_back();
+    scopes_.pop_back();
+}
+
+const ConstantEnvironment::Builder::Declared &
+ConstantEnvironment::Builder::declare(TSNode name, std::string_view type, bool tracked, bool immutable) {
+    uint32_t ordinal = ordinal_++;
+    if (!evaluate_) unstable_.push_back(false);
+    std::string_view text = node_text(name, code_);
+    visible_[text].push_back(static_cast<uint32_t>(declared_.size()));
+    declared_.push_back({text, type, static_cast<uint32_t>(scopes_.size() - 1), ordinal, tracked, immutable});
+    return declared_.back();
+}
+
+// Parameters hold unknown values, but may be assigned like any local; they
+// also hide outer locals of the same name inside lambdas and local classes.
+void ConstantEnvironment::Builder::declare_parameters(TSNode parameters) {
+    const CppGrammar &g = cpp_grammar();
+    for_each_child(parameters, [&](TSNode parameter) {
+        TSNode declarator = ts_node_child_by_field_id(parameter, g.field_declarator);
+        TSNode name = declared_name(declarator);
+        if (ts_node_is_null(name)) return;
+        std::string_view type = node_text(ts_node_child_by_field_id(parameter, g.field_type), code_);
+        bool tracked = ts_node_symbol(declarator) == g.identifier && integral(type);
+        const Declared &declared = declare(name, type, tracked, false);
+        if (evaluate_) environment_.add(declared.name, ts_node_start_byte(name), scopes_.back().end, ConstantValue());
+    });
+}
+
+ConstantValue ConstantEnvironment::Builder::convert(const ConstantValue &value, std::string_view type) const {
+    return type == "auto" ? value : cast_constant(value, type);
+}
+
+bool ConstantEnvironment::Builder::integral(std::string_view type) const {
+    return type == "auto" || cast_constant(ConstantValue::of(0), type).known();
+}
+
+void ConstantEnvironment::Builder::on_declaration(TSNode declaration) {
+    const CppGrammar &g = cpp_grammar();
+    TSNode type_node = ts_node_child_by_field_id(declaration, g.field_type);
+    std::string_view type = ts_node_is_null(type_node) ? std::string_view() : node_text(type_node, code_);
+    bool immutable = false, is_volatile = false, is_static = false;
+    for_each_child(declaration, [&](TSNode child) {
+        TSSymbol symbol = ts_node_symbol(child);
+        std::string_view text = node_text(child, code_);
+        if (symbol == g.type_qualifier) {
+            immutable |= text == "const" || text == "constexpr";
+            is_volatile |= text == "volatile";
+        } else if (symbol == g.storage_class_specifier) {
+            // Statics keep their value between calls; externs live elsewhere.
+            is_static |= text != "register";
+        }
+    });
+    bool tracked_type = integral(type) && !is_volatile && (immutable || !is_static);
+
+    for_each_child(declaration, [&](TSNode child) {
+        if (ts_node_eq(child, type_node)) return;
+        bool initialized = ts_node_symbol(child) == g.init_declarator;
+        TSNode declarator = initialized ? ts_node_child_by_field_id(child, g.field_declarator) : child;
+        TSNode name = declared_name(declarator);
+        if (ts_node_is_null(name)) return;
+        bool tracked = tracked_type && ts_node_symbol(declarator) == g.identifier;
+        const Declared &declared = declare(name, type, tracked, immutable);
+        if (!evaluate_) return;
+        ConstantValue value;
+        TSNode initializer = initialized ? ts_node_child_by_field_id(child, g.field_value) : TSNode{};
+        if (tracked && !ts_node_is_null(initializer) && !unstable(declared)) {
+            value = convert(evaluator_.evaluate(initializer), type);
+        }
+        environment_.add(declared.name, ts_node_end_byte(child), scopes_.back().end, value);
+    });
+}
+
+const ConstantEnvironment::Builder::Declared *ConstantEnvironment::Builder::resolve(TSNode identifier) const {
+    if (ts_node_is_null(identifier) || ts_node_symbol(identifier) != cpp_grammar().identifier) return nullptr;
+    auto found = visible_.find(node_text(identifier, code_));
+    if (found == visible_.end() || found->second.empty()) return nullptr;
+    return &declared_[found->second.back()];
+}
+
+// A write to `target` by `write`, an assignment or ++/--. Only one that is a
+// statement of its own in a block dominates what follows it there.
+void ConstantEnvironment::Builder::on_write(TSNode target, TSNode write, uint32_t depth) {
+    const CppGrammar &g = cpp_grammar();
+    const Declared *declared = resolve(target);
+    if (!declared || !declared->tracked || declared->immutable) return;
+    bool direct = depth >= 2 && ts_node_symbol(path_[depth - 1]) == g.expression_statement &&
+                  ts_node_symbol(path_[depth - 2]) == g.compound_statement;
+    if (!direct) return on_escape(target);
+
+    const Scope &block = scopes_.back(); // the compound_statement holding the statement
+    const Scope &scope = scopes_[declared->scope];
+    if (!evaluate_) {
+        auto loop = std::lower_bound(loops_.begin(), loops_.end(), declared->scope);
+        if (loop != loops_.end() && *loop == declared->scope) {
+            unstable_[declared->ordinal] = true;
+        } else if (loop != loops_.end()) {
+            environment_.add(declared->name, scopes_[*loop].start, scope.end, ConstantValue());
+        }
+        if (block.id != scope.id) environment_.add(declared->name, block.end, scope.end, ConstantValue());
+        return;
+    }
+    if (has_goto_) return;
+
+    TSSymbol symbol = ts_node_symbol(write);
+    std::string_view op = node_text(ts_node_child_by_field_id(write, g.field_operator), code_);
+    ConstantValue value;
+    if (symbol == g.update_expression) {
+        value = fold_binary(op == "++" ? "+" : "-", evaluator_.evaluate(target), ConstantValue::of(1));
+    } else {
+        ConstantValue right = evaluator_.evaluate(ts_node_child_by_field_id(write, g.field_right));
+        if (op == "=") {
+            value = right;
+        } else {
+            // `+=` folds as `+`; and_eq, or_eq and xor_eq as their operators.
+            std::string_view base = op == "and_eq" ? "&" : op == "or_eq" ? "|" : op == "xor_eq" ? "^" : op.substr(0, op.size() - 1);
+            value = fold_binary(base, evaluator_.evaluate(target), right);
+        }
+    }
+    environment_.add(declared->name, ts_node_end_byte(path_[depth - 1]), block.end, convert(value, declared->type));
+}
+
+// `target` may change here in a way that is not followed: it is unknown from
+// this point (from the start of an enclosing loop, if any) to the end of its
+// scope, and over its whole scope if that is the loop itself.
+void ConstantEnvironment::Builder::on_escape(TSNode target) {
+    if (evaluate_) return;
+    const Declared *declared = resolve(target);
+    if (!declared || !declared->tracked || declared->immutable) return;
+    uint32_t start = ts_node_start_byte(target);
+    auto loop = std::lower_bound(loops_.begin(), loops_.end(), declared->scope);
+    if (loop != loops_.end() && *loop == declared->scope) {
+        unstable_[declared->ordinal] = true;
+    } else if (loop != loops_.end()) {
+        start = scopes_[*loop].start;
+    }
+    environment_.add(declared->name, start, scopes_[declared->scope].end, ConstantValue());
+}
+
+// Whether the identifier at `depth` may be bound to a non-const reference:
+// an argument of a call, or an operand of `>>` or `<<`, which stream
+// extraction (`std::cin >> n`) writes through. Parentheses, conditionals and
+// commas around it pass the variable itself on.
+bool ConstantEnvironment::Builder::by_reference(uint32_t depth) const {
+    const CppGrammar &g = cpp_grammar();
+    uint32_t up = depth - 1;
+    while (up > 0 && (ts_node_symbol(path_[up]) == g.parenthesized_expression ||
+                      ts_node_symbol(path_[up]) == g.conditional_expression ||
+                      ts_node_symbol(path_[up]) == g.comma_expression)) {
+        up--;
+    }
+    TSSymbol parent = ts_node_symbol(path_[up]);
+    if (parent == g.argument_list) return true;
+    if (parent != g.binary_expression) return false;
+    std::string_view op = node_text(ts_node_child_by_field_id(path_[up], g.field_operator), code_);
+    return op == ">>" || op == "<<";
+}
+
+void ConstantEnvironment::Builder::run(TSNode function, TSNode body) {
+    const CppGrammar &g = cpp_grammar();
+    TSNode parameters = parameters_of(ts_node_child_by_field_id(function, g.field_declarator));
+    walker_.walk(body, [&](TSNode node, uint32_t depth) {
+        if (path_.size() <= depth) path_.resize(depth + 1);
+        path_[depth] = node;
+        TSSymbol symbol = ts_node_symbol(node);
+        if (symbol == g.compound_statement || symbol == g.if_statement || symbol == g.switch_statement ||
+            symbol == g.catch_clause) {
+            open_scope(node, false);
+            if (depth == 0) declare_parameters(parameters);
+            if (symbol == g.catch_clause) declare_parameters(ts_node_child_by_field_id(node, g.field_parameters));
+        } else if (symbol == g.for_statement || symbol == g.while_statement || symbol == g.do_statement) {
+            open_scope(node, true);
+        } else if (symbol == g.for_range_loop) {
+            open_scope(node, true);
+            TSNode name = declared_name(ts_node_child_by_field_id(node, g.field_declarator));
+            if (!ts_node_is_null(name)) {
+                const Declared &declared = declare(name, std::string_view(), false, false);
+                if (evaluate_) environment_.add(declared.name, ts_node_start_byte(name), ts_node_end_byte(node), ConstantValue());
+            }
+        } else if (symbol == g.lambda_expression || symbol == g.function_definition) {
+            // Runs any number of times, at points the walk cannot see.
+            open_scope(node, true);
+            declare_parameters(parameters_of(ts_node_child_by_field_id(node, g.field_declarator)));
+        } else if (symbol == g.declaration) {
+            on_declaration(node);
+        } else if (symbol == g.assignment_expression) {
+            on_write(ts_node_child_by_field_id(node, g.field_left), node, depth);
+        } else if (symbol == g.update_expression) {
+            on_write(ts_node_child_by_field_id(node, g.field_argument), node, depth);
+        } else if (symbol == g.pointer_expression) {
+            if (node_text(ts_node_child_by_field_id(node, g.field_operator), code_) == "&") {
+                on_escape(ts_node_child_by_field_id(node, g.field_argument));
+            }
+        } else if (symbol == g.identifier && depth > 0 && by_reference(depth)) {
+            on_escape(node);
+        } else if (symbol == g.init_declarator) {
+            TSNode bound = ts_node_child_by_field_id(node, g.field_declarator);
+            if (ts_node_symbol(bound) == g.reference_declarator) on_escape(ts_node_child_by_field_id(node, g.field_value));
+        } else if (symbol == g.goto_statement && !evaluate_) {
+            has_goto_ = true;
+        }
+        return Visit::Continue;
+    }, [&](TSNode node, uint32_t) {
+        if (!scopes_.empty() && scopes_.back().id == node.id) close_scope();
+    });
+}
+
+void ConstantEnvironment::build(TSNode function, std::string_view code) {
+    clear();
+    TSNode body = ts_node_child_by_field_id(function, cpp_grammar().field_body);
+    if (ts_node_is_null(body)) return;
+    std::vector<bool> unstable;
+    bool has_goto = false;
+    Builder(*this, code, false, unstable, has_goto).run(function, body);
+    Builder(*this, code, true, unstable, has_goto).run(function, body);
+}
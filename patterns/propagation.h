@@ -0,0 +1,51 @@
+#pragma once
+#include "common.h"
+#include "constant_evaluator.h"
+
+// Values of a function's local variables at every point of its body, from an
+// intra-procedural constant propagation run once per function. Statements of
+// structured code are visited in source order, which is dominating order: a
+// declaration dominates the rest of its scope, and a statement of a block the
+// statements after it in that block. Each declaration and each assignment
+// (`=`, compound or ++/--) that is a statement of a block opens a segment of
+// bytes where the variable holds the folded value. Writes that may or may not
+// have happened by some point make the variable unknown from there on:
+//
+// - a write in a nested block, after that block;
+// - a write inside a loop or lambda, from the start of the outermost one
+//   within the variable's scope;
+// - any other write (inside an expression, a case, a condition), taking the
+//   address, binding a reference or passing the variable to a call (which may
+//   take it by reference), from that point.
+//
+// `const`/`constexpr` locals are never invalidated. Functions containing goto
+// only keep those; static locals and types other than the integer ones
+// cast_constant knows are always unknown.
+class ConstantEnvironment {
+public:
+    // Computes the environment of `function` (a function_definition) in two
+    // linear walks of its body. `code` must outlive the lookups.
+    void build(TSNode function, std::string_view code);
+    void clear() { segments_.clear(); }
+
+    // Value at `byte` of the local or parameter `name` refers to there; false
+    // when no local of that name is in scope.
+    bool lookup(std::string_view name, uint32_t byte, ConstantValue &value) const;
+
+private:
+    class Builder;
+
+    // Bytes [start, end) over which a variable holds `value`. Scopes nest and
+    // later writes start later, so the segment in force at a byte is the last
+    // one starting at or before it that has not ended.
+    struct Segment {
+        uint32_t start;
+        uint32_t end;
+        ConstantValue value;
+    };
+
+    // Keeps each name's segments sorted by start; equal starts keep insertion order.
+    void add(std::string_view name, uint32_t start, uint32_t end, const ConstantValue &value);
+
+    std::unordered_map<std::string_view, std::vector<Segment>> segments_;
+};
@@ -0,0 +1,69 @@
+#include "query.h"
+#include "arena.h"
+#include <map>
+#include <memory>
+#include <mutex>
+
+static const char *error_kind(TSQueryError error) {
+    switch (error) {
+        case TSQueryErrorSyntax: return "syntax error";
+        case TSQueryErrorNodeType: return "unknown node type";
+        case TSQueryErrorField: return "unknown field";
+        case TSQueryErrorCapture: return "unknown capture";
+        case TSQueryErrorStructure: return "impossible pattern";
+        case TSQueryErrorLanguage: return "incompatible language";
+        default: return "error";
+    }
+}
+
+Query::Query(std::string_view source) {
+    // Compiled queries are cached for the life of the process, so they never
+    // come from a per-file arena.
+    ArenaScope heap(nullptr);
+    uint32_t error_offset = 0;
+    TSQueryError error = TSQueryErrorNone;
+    query_ = ts_query_new(tree_sitter_cpp(), source.data(), static_cast<uint32_t>(source.size()),
+                          &error_offset, &error);
+    if (!query_) {
+        throw std::runtime_error("Error: query " + std::string(error_kind(error)) + " at offset " +
+                                 std::to_string(error_offset) + ": " +
+                                 std::string(source.substr(error_offset, 40)));
+    }
+}
+
+Query::~Query() {
+    ts_query_delete(query_);
+}
+
+uint32_t Query::pattern_count() const {
+    return ts_query_pattern_count(query_);
+}
+
+uint32_t Query::capture_count() const {
+    return ts_query_capture_count(query_);
+}
+
+std::string_view Query::capture_name(uint32_t id) const {
+    uint32_t length = 0;
+    const char *name = ts_query_capture_name_for_id(query_, id, &length);
+    return std::string_view(name, length);
+}
+
+uint32_t Query::capture_id(std::string_view name) const {
+    for (uint32_t id = 0; id < capture_count(); id++) {
+        if (capture_name(id) == name) return id;
+    }
+    return UINT32_MAX;
+}
+
+const Query &shared_query(std::string_view source) {
+    static std::mutex mutex;
+    static std::map<std::string, std::unique_ptr<Query>, std::less<>> queries;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = queries.find(source);
+    if (it == queries.end()) {
+        auto query = std::make_unique<Query>(source);
+        it = queries.emplace(std::string(source), std::move(query)).first;
+    }
+    return *it->second;
+}
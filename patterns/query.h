@@ -0,0 +1,77 @@
+#pragma once
+#include "common.h"
+#include "budget.h"
+
+// A compiled tree-sitter query. Compiling is the expensive part and a TSQuery
+// is immutable once built, so one instance is shared by every thread; only
+// the cursor that runs it is per-thread.
+class Query {
+public:
+    // Compiles `source` for the C++ grammar. Throws std::runtime_error naming
+    // the offset and kind of the first error.
+    explicit Query(std::string_view source);
+    ~Query();
+    Query(const Query &) = delete;
+    Query &operator=(const Query &) = delete;
+
+    const TSQuery *get() const { return query_; }
+    uint32_t pattern_count() const;
+    uint32_t capture_count() const;
+    std::string_view capture_name(uint32_t id) const;
+
+    // Id of capture `@name`, or UINT32_MAX if the query has no such capture.
+    uint32_t capture_id(std::string_view name) const;
+
+private:
+    TSQuery *query_;
+};
+
+// The process-wide compiled form of `source`, compiled on first use. Safe to
+// call from several threads; the reference stays valid until exit.
+const Query &shared_query(std::string_view source);
+
+// One match handed to a checker: the pattern's index within the checker's own
+// query and its captures, with capture ids of that query.
+struct QueryMatch {
+    uint32_t pattern;
+    const TSQueryCapture *captures;
+    uint32_t capture_count;
+
+    // First node captured as `id`, or a null node.
+    TSNode capture(uint32_t id) const {
+        for (uint32_t i = 0; i < capture_count; i++) {
+            if (captures[i].index == id) return captures[i].node;
+        }
+        return TSNode{};
+    }
+};
+
+// Runs queries over a tree. Reusable across runs; not thread-safe. The
+// underlying cursor is only created by the first exec().
+class QueryCursor {
+public:
+    QueryCursor() = default;
+    ~QueryCursor() {
+        if (cursor_) ts_query_cursor_delete(cursor_);
+    }
+    QueryCursor(const QueryCursor &) = delete;
+    QueryCursor &operator=(const QueryCursor &) = delete;
+
+    // Starts matching `query` under `node`, limited to matches that intersect
+    // [start_byte, end_byte).
+    void exec(const Query &query, TSNode node, uint32_t start_byte = 0, uint32_t end_byte = UINT32_MAX) {
+        if (!cursor_) cursor_ = ts_query_cursor_new();
+        ts_query_cursor_set_byte_range(cursor_, start_byte, end_byte);
+        // The cursor keeps a pointer to the options, so they must be static.
+        static const TSQueryCursorOptions options = {nullptr, over_budget};
+        ts_query_cursor_exec_with_options(cursor_, query.get(), node, &options);
+    }
+
+    // False at the end, or once the calling thread's budget has run out.
+    bool next(TSQueryMatch &match) { return ts_query_cursor_next_match(cursor_, &match); }
+
+private:
+    static bool over_budget(TSQueryCursorState *) { return budget_expired(); }
+
+    TSQueryCursor *cursor_ = nullptr;
+};
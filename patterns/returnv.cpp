@@ -1,74 +1,269 @@
-#include "common.h"
-#include "constant_evaluator.h"  // Include our evaluator
+#include "returnv.h"
+#include "functions.h"
+#include <iomanip>
+
+// Active branches always belong to ancestors of the current node (they are
+// popped in leave), so only the innermost one can exclude it.
+static bool outside_branch(const std::vector<PrunedBranch> &branches, TSNode node) {
+    if (branches.empty() || branches.back().if_id == node.id) return false;
+    const PrunedBranch &branch = branches.back();
+    return ts_node_start_byte(node) < branch.start_byte || ts_node_end_byte(node) > branch.end_byte;
+}
+
+// Limits the walk below an if-statement to the branch taken when its
+// condition folds; a false condition without an else walks nothing.
+static void fold_if(TSNode node, ConstantEvaluator &evaluator, std::vector<PrunedBranch> &branches) {
+    const CppGrammar &g = cpp_grammar();
+    ConstantValue condition = evaluator.evaluate(ts_node_child_by_field_id(node, g.field_condition));
+    if (condition.is_true()) {
+        TSNode branch = ts_node_child_by_field_id(node, g.field_consequence);
+        branches.push_back({node.id, ts_node_start_byte(branch), ts_node_end_byte(branch)});
+    } else if (condition.is_false()) {
+        TSNode branch = ts_node_child_by_field_id(node, g.field_alternative);
+        uint32_t start = ts_node_is_null(branch) ? ts_node_start_byte(node) : ts_node_start_byte(branch);
+        uint32_t end = ts_node_is_null(branch) ? start : ts_node_end_byte(branch);
+        branches.push_back({node.id, start, end});
+    }
+}
+
+ReturnValueChecker::ReturnValueChecker(const std::string& function_name, std::vector<std::string>& return_values, bool in_function)
+    : function_name_(function_name), return_values_(return_values), in_function_(in_function) {}
+
+std::vector<TSSymbol> ReturnValueChecker::subscriptions(const CppGrammar &g) const {
+    return {g.return_statement, g.if_statement, g.function_definition};
+}
+
+void ReturnValueChecker::begin(std::string_view code) {
+    code_ = code;
+    function_id_ = nullptr;
+    branches_.clear();
+    environment_.clear();
+    evaluator_.reset(code);
+    evaluator_.set_environment(&environment_);
+}
+
+bool ReturnValueChecker::pruned(TSNode node) const {
+    return outside_branch(branches_, node);
+}
+
+Visit ReturnValueChecker::enter(TSNode node, uint32_t) {
+    if (pruned(node)) return Visit::SkipChildren;
+    const CppGrammar &g = cpp_grammar();
+    std::string_view code = code_;
+    TSSymbol type = ts_node_symbol(node);
 
-// Return value collector
-// This function will collect the possible return values for a specific function
-std::vector<std::string> collect_return_values(TSNode node, const std::string& code, const std::string& function_name, bool in_function = false) {
     // If we see a return_statement in a function, extract its value.
-    if (!strcmp(ts_node_type(node), "return_statement") && in_function) {
-        TSNode return_value = ts_node_child(node, 1);
-        std::string return_value_text = ts_node_string(return_value, code);
-        return std::vector<std::string>{return_value_text};
+    if (type == g.return_statement) {
+        if (!in_function_ && !function_id_) return Visit::Continue;
+        // `return;` has no value; an empty one is recorded.
+        TSNode return_value = ts_node_named_child(node, 0);
+        bool bare = ts_node_is_null(return_value) || ts_node_symbol(return_value) == g.comment;
+        return_values_.push_back(bare ? std::string() : ts_node_string(return_value, code));
+        return Visit::Stop;
     }
-    
+
     // Handle if-statements by evaluating their condition.
-    if (!strcmp(ts_node_type(node), "if_statement")) {
-        // Adjust these child indices according to the actual Tree-sitter C++ grammar.
-        // For this example, assume:
-        // child 0: "if" keyword
-        // child 1: condition
-        // child 2: then branch
-        // child 3: optional "else" keyword
-        // child 4: optional else branch
-        TSNode condition = ts_node_child(node, 1);
-        TSNode if_body   = ts_node_child(node, 2);
-        
-        // Create a simple variables map. Extend this if you need to evaluate identifiers.
-        std::unordered_map<std::string, int> variables;
-        if (is_constant_true(condition, code, variables)) {
-            return collect_return_values(if_body, code, function_name, in_function);
+    if (type == g.if_statement) {
+        fold_if(node, evaluator_, branches_);
+        return Visit::Continue;
+    }
+
+    // Handle function definitions.
+    if (type == g.function_definition && !function_id_) {
+        if (defined_name(node, code) == function_name_) {
+            function_id_ = node.id;
+            environment_.build(node, code);
+            evaluator_.set_environment(&environment_);
+        }
+    }
+    return Visit::Continue;
+}
+
+void ReturnValueChecker::leave(TSNode node, uint32_t) {
+    if (!branches_.empty() && branches_.back().if_id == node.id) {
+        branches_.pop_back();
+    } else if (node.id == function_id_) {
+        function_id_ = nullptr;
+    }
+}
+
+// Return value collector
+// This function will collect the possible return values for a specific function
+// by running a ReturnValueChecker on its own.
+std::vector<std::string> collect_return_values(TSNode node, std::string_view code, const std::string& function_name, bool in_function) {
+    std::vector<std::string> return_values;
+    ReturnValueChecker checker(function_name, return_values, in_function);
+    CheckerPipeline pipeline;
+    pipeline.add(checker);
+    pipeline.run(node, code);
+    return return_values;
+}
+
+ReturnSummaryChecker::ReturnSummaryChecker(std::vector<ReturnSummary> &summaries, const std::string &scope)
+    : summaries_(summaries), scope_(scope) {}
+
+std::vector<TSSymbol> ReturnSummaryChecker::subscriptions(const CppGrammar &g) const {
+    return {g.function_definition, g.lambda_expression, g.return_statement, g.if_statement, g.call_expression,
+            g.namespace_definition, g.class_specifier, g.struct_specifier, g.union_specifier};
+}
+
+void ReturnSummaryChecker::begin(std::string_view code) {
+    code_ = code;
+    prefix_ = scope_;
+    scopes_.clear();
+    open_.clear();
+    branches_.clear();
+    evaluator_.reset(code);
+    evaluator_.set_environment(nullptr);
+}
+
+bool ReturnSummaryChecker::pruned(TSNode node) const {
+    return outside_branch(branches_, node);
+}
+
+// The return type a function definition declares, with a `*` or `&` for each
+// pointer or reference declarator around its function_declarator; empty for
+// constructors and destructors.
+static std::string declared_type(TSNode function, std::string_view code) {
+    const CppGrammar &g = cpp_grammar();
+    TSNode type = ts_node_child_by_field_id(function, g.field_type);
+    if (ts_node_is_null(type)) return std::string();
+    std::string text(node_text(type, code));
+    TSNode declarator = ts_node_child_by_field_id(function, g.field_declarator);
+    while (!ts_node_is_null(declarator) && ts_node_symbol(declarator) != g.function_declarator) {
+        if (ts_node_symbol(declarator) == g.reference_declarator) {
+            text += '&';
+            declarator = ts_node_named_child(declarator, 0);
         } else {
-            // If there is an else branch, process it.
-            if (ts_node_child_count(node) >= 5) {
-                TSNode else_body = ts_node_child(node, 4);
-                return collect_return_values(else_body, code, function_name, in_function);
-            }
+            if (ts_node_symbol(declarator) == g.pointer_declarator) text += '*';
+            declarator = ts_node_child_by_field_id(declarator, g.field_declarator);
         }
     }
-    
-    // Handle function definitions.
-    if (!strcmp(ts_node_type(node), "function_definition")) {
-        TSNode function_declarator = ts_node_child(node, 1);
-        TSNode identifier_node = ts_node_child(function_declarator, 0);
-        std::string current_function_name = ts_node_string(identifier_node, code);
-        if (current_function_name == function_name) {
-            TSNode function_body = ts_node_child(node, 2);
-            std::vector<std::string> return_values;
-            uint32_t child_count = ts_node_child_count(function_body);
-            for (uint32_t i = 0; i < child_count; ++i) {
-                TSNode child = ts_node_child(function_body, i);
-                std::vector<std::string> stm_returns = collect_return_values(child, code, function_name, true);
-                return_values.insert(return_values.end(), stm_returns.begin(), stm_returns.end());
-                // Stop traversing if an unconditional return is encountered.
-                if (!stm_returns.empty()) {
-                    break;
+    return text;
+}
+
+Visit ReturnSummaryChecker::enter(TSNode node, uint32_t) {
+    if (pruned(node)) return Visit::SkipChildren;
+    const CppGrammar &g = cpp_grammar();
+    TSSymbol type = ts_node_symbol(node);
+
+    if (type == g.return_statement) {
+        if (open_.empty() || open_.back().summary == UINT32_MAX) return Visit::Continue;
+        ReturnSummary &summary = summaries_[open_.back().summary];
+        if (summary.returns) return Visit::Continue;
+        summary.returns = true;
+        if (ts_node_named_child_count(node) > 0) {
+            TSNode value = ts_node_named_child(node, 0);
+            if (ts_node_symbol(value) != g.comment) {
+                summary.value = ts_node_string(value, code_);
+                summary.constant = evaluator_.evaluate(value);
+                while (ts_node_symbol(value) == g.parenthesized_expression && ts_node_named_child_count(value) == 1) {
+                    value = ts_node_named_child(value, 0);
+                }
+                if (summary.constant.status == ConstantValue::Unknown && ts_node_symbol(value) == g.call_expression) {
+                    summary.forward = callee_name(value, code_);
                 }
             }
-            return return_values;
         }
+        // Calls in the returned expression still count.
+        return Visit::Continue;
     }
-    
-    // Default: recursively check all child nodes.
-    uint32_t child_count = ts_node_child_count(node);
-    std::vector<std::string> return_values;
-    for (uint32_t i = 0; i < child_count; ++i) {
-        TSNode child = ts_node_child(node, i);
-        std::vector<std::string> child_returns = collect_return_values(child, code, function_name, in_function);
-        return_values.insert(return_values.end(), child_returns.begin(), child_returns.end());
-        // Propagate an unconditional return if found.
-        if (!child_returns.empty()) {
+
+    if (type == g.call_expression) {
+        // A call in a lambda is charged to the function the lambda is in.
+        for (auto it = open_.rbegin(); it != open_.rend(); ++it) {
+            if (it->summary == UINT32_MAX) continue;
+            std::string callee = callee_name(node, code_);
+            if (!callee.empty()) summaries_[it->summary].calls.push_back(std::move(callee));
             break;
         }
+        return Visit::Continue;
     }
-    return return_values;
+
+    if (type == g.if_statement) {
+        // Once a function has its return, its remaining branches do not matter.
+        if (!open_.empty() && (open_.back().summary == UINT32_MAX || !summaries_[open_.back().summary].returns)) {
+            fold_if(node, evaluator_, branches_);
+        }
+        return Visit::Continue;
+    }
+
+    if (type == g.function_definition) {
+        uint32_t index = static_cast<uint32_t>(summaries_.size());
+        summaries_.push_back({prefix_ + std::string(defined_name(node, code_)), std::string(), ts_node_start_byte(node), false,
+                              declared_type(node, code_), ConstantValue(), std::string(), {}});
+        open_.push_back({node.id, index, std::make_unique<ConstantEnvironment>()});
+        open_.back().environment->build(node, code_);
+        evaluator_.set_environment(open_.back().environment.get());
+        return Visit::Continue;
+    }
+
+    if (type == g.lambda_expression) {
+        open_.push_back({node.id, UINT32_MAX, nullptr});
+        return Visit::Continue;
+    }
+
+    // Namespaces and classes qualify the functions defined inside them;
+    // anonymous ones add nothing.
+    TSNode name = ts_node_child_by_field_id(node, g.field_name);
+    scopes_.push_back({node.id, prefix_.size()});
+    if (!ts_node_is_null(name)) prefix_.append(node_text(name, code_)).append("::");
+    return Visit::Continue;
+}
+
+void ReturnSummaryChecker::leave(TSNode node, uint32_t) {
+    if (!branches_.empty() && branches_.back().if_id == node.id) {
+        branches_.pop_back();
+    } else if (!open_.empty() && open_.back().id == node.id) {
+        if (open_.back().summary != UINT32_MAX) {
+            std::vector<std::string> &calls = summaries_[open_.back().summary].calls;
+            std::sort(calls.begin(), calls.end());
+            calls.erase(std::unique(calls.begin(), calls.end()), calls.end());
+        }
+        bool had_environment = open_.back().environment != nullptr;
+        open_.pop_back();
+        if (had_environment) {
+            // Back to the enclosing function's environment, if any.
+            const ConstantEnvironment *environment = nullptr;
+            for (auto it = open_.rbegin(); it != open_.rend() && !environment; ++it) environment = it->environment.get();
+            evaluator_.set_environment(environment);
+        }
+    } else if (!scopes_.empty() && scopes_.back().id == node.id) {
+        prefix_.resize(scopes_.back().prefix_size);
+        scopes_.pop_back();
+    }
+}
+
+void ReturnSummaryChecker::finish() {
+    sort_return_summaries(summaries_);
+}
+
+void sort_return_summaries(std::vector<ReturnSummary> &summaries) {
+    std::stable_sort(summaries.begin(), summaries.end(),
+                     [](const ReturnSummary &a, const ReturnSummary &b) { return a.name < b.name; });
+}
+
+const ReturnSummary *find_return_summary(const std::vector<ReturnSummary> &summaries, std::string_view name) {
+    auto found = std::lower_bound(summaries.begin(), summaries.end(), name,
+                                  [](const ReturnSummary &summary, std::string_view key) { return summary.name < key; });
+    return found != summaries.end() && found->name == name ? &*found : nullptr;
+}
+
+std::vector<ReturnSummary> summarize_return_values(TSNode node, std::string_view code) {
+    std::vector<ReturnSummary> summaries;
+    ReturnSummaryChecker checker(summaries);
+    CheckerPipeline pipeline;
+    pipeline.add(checker);
+    pipeline.run(node, code);
+    return summaries;
+}
+
+void print_return_summaries(const std::vector<ReturnSummary> &summaries, std::ostream &out) {
+    out << "-------------------------------------------------------------\n";
+    out << std::left << std::setw(40) << "Function" << "Return Value" << "\n";
+    out << "-------------------------------------------------------------\n";
+    for (const ReturnSummary &summary : summaries) {
+        out << std::left << std::setw(40) << summary.name << (summary.returns ? summary.value : "-") << "\n";
+    }
+    out << "-------------------------------------------------------------\n";
 }
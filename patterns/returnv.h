@@ -0,0 +1,115 @@
+#pragma once
+#include "common.h"
+#include "checker.h"
+#include "propagation.h"
+#include <memory>
+
+// An if-statement whose condition folded: only [start_byte, end_byte) below it
+// is walked (nothing, when the range is empty).
+struct PrunedBranch {
+    const void *if_id;
+    uint32_t start_byte;
+    uint32_t end_byte;
+};
+
+// Finds the value of the first return statement reached in one named
+// function, following if-statements whose condition folds to a constant:
+// only the branch taken is walked. Conditions are folded by one evaluator
+// per run, so subexpressions shared between conditions fold once, against
+// the constant environment of the named function, built once on entering it
+// (with `in_function`, conditions see literals only).
+// At most one value is collected; the checker stops once it has it.
+class ReturnValueChecker : public Checker {
+public:
+    ReturnValueChecker(const std::string& function_name, std::vector<std::string>& return_values, bool in_function = false);
+
+    std::vector<TSSymbol> subscriptions(const CppGrammar &g) const override;
+    void begin(std::string_view code) override;
+    Visit enter(TSNode node, uint32_t depth) override;
+    void leave(TSNode node, uint32_t depth) override;
+
+private:
+    bool pruned(TSNode node) const;
+
+    const std::string& function_name_;
+    std::vector<std::string>& return_values_;
+    std::string_view code_;
+    bool in_function_;
+    const void *function_id_ = nullptr;
+    std::vector<PrunedBranch> branches_;
+    ConstantEnvironment environment_;
+    ConstantEvaluator evaluator_;
+};
+
+// First return value reached in one function definition, with what a
+// CallGraph needs to follow it into other functions.
+struct ReturnSummary {
+    std::string name;    // qualified: enclosing namespaces and classes, then the declarator's own name
+    std::string value;   // text of the returned expression; empty for `return;` or when none is reached
+    uint32_t start_byte; // of the definition
+    bool returns;        // a return statement was reached
+    std::string type;    // declared return type, with `*`/`&` for pointer and reference declarators
+    ConstantValue constant; // `value` folded in the function's own constant environment
+    std::string forward; // callee of `value` when it is a bare call that did not fold, as written
+    std::vector<std::string> calls; // functions called in the body (lambdas included), as written, sorted
+};
+
+// The ReturnValueChecker walk for every function definition at once: each
+// function gets its own constant environment, built when the walk enters it,
+// and keeps its own first return, so a file costs one traversal however many
+// functions it defines. Returns inside lambdas belong to the lambda and are
+// skipped. On finish the summaries are sorted by name, overloads in source
+// order.
+class ReturnSummaryChecker : public Checker {
+public:
+    // `scope` qualifies every name, for walks that start inside namespaces.
+    explicit ReturnSummaryChecker(std::vector<ReturnSummary> &summaries, const std::string &scope = std::string());
+
+    std::vector<TSSymbol> subscriptions(const CppGrammar &g) const override;
+    void begin(std::string_view code) override;
+    Visit enter(TSNode node, uint32_t depth) override;
+    void leave(TSNode node, uint32_t depth) override;
+    void finish() override;
+
+private:
+    // A function or lambda being walked; `summary` is UINT32_MAX for a lambda.
+    struct Open {
+        const void *id;
+        uint32_t summary;
+        std::unique_ptr<ConstantEnvironment> environment;
+    };
+
+    // A namespace or class; `prefix_` is cut back to `prefix_size` when it ends.
+    struct Scope {
+        const void *id;
+        size_t prefix_size;
+    };
+
+    bool pruned(TSNode node) const;
+
+    std::vector<ReturnSummary> &summaries_;
+    std::string_view code_;
+    std::string scope_;
+    std::string prefix_; // qualified name of the innermost scope, with a trailing "::"
+    std::vector<Scope> scopes_;
+    std::vector<Open> open_;
+    std::vector<PrunedBranch> branches_;
+    ConstantEvaluator evaluator_;
+};
+
+// Sorts by name, keeping source order among equal names.
+void sort_return_summaries(std::vector<ReturnSummary> &summaries);
+
+// First summary named `name` in a table sorted by sort_return_summaries, or null.
+const ReturnSummary *find_return_summary(const std::vector<ReturnSummary> &summaries, std::string_view name);
+
+// Runs a ReturnSummaryChecker on its own over `node`.
+std::vector<ReturnSummary> summarize_return_values(TSNode node, std::string_view code);
+
+// Writes `summaries` as a two-column name / value table.
+void print_return_summaries(const std::vector<ReturnSummary> &summaries, std::ostream &out = std::cout);
+
+// Return value collector
+// Collects the value of the first return statement reached in `function_name`,
+// following if-statements whose condition folds to a constant.
+std::vector<std::string> collect_return_values(TSNode node, std::string_view code, const std::string& function_name, bool in_function = false);
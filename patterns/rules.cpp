@@ -0,0 +1,171 @@
+#include "rules.h"
+#include <map>
+#include <mutex>
+#include <regex>
+
+namespace {
+
+struct Predicate {
+    enum Kind { Eq, NotEq, Match, NotMatch, AnyOf } kind;
+    uint32_t capture;
+    uint32_t other_capture = UINT32_MAX; // #eq? against another capture
+    std::vector<std::string> values;
+    std::regex pattern;
+};
+
+struct Rule {
+    std::string message;
+    std::vector<Predicate> predicates;
+};
+
+// One predicate or directive: `#name` and its arguments, each either a
+// capture id or a string.
+struct Call {
+    std::string name;
+    std::vector<std::pair<bool, std::string_view>> args; // (is capture, string or capture name)
+    std::vector<uint32_t> capture_ids;                   // parallel to args; UINT32_MAX for strings
+};
+
+std::vector<Call> calls_for_pattern(const Query &query, uint32_t pattern) {
+    uint32_t step_count = 0;
+    const TSQueryPredicateStep *steps = ts_query_predicates_for_pattern(query.get(), pattern, &step_count);
+    std::vector<Call> calls;
+    Call current;
+    for (uint32_t i = 0; i < step_count; i++) {
+        const TSQueryPredicateStep &step = steps[i];
+        if (step.type == TSQueryPredicateStepTypeDone) {
+            calls.push_back(std::move(current));
+            current = Call();
+        } else if (step.type == TSQueryPredicateStepTypeCapture) {
+            current.args.emplace_back(true, query.capture_name(step.value_id));
+            current.capture_ids.push_back(step.value_id);
+        } else {
+            uint32_t length = 0;
+            const char *text = ts_query_string_value_for_id(query.get(), step.value_id, &length);
+            if (current.name.empty()) {
+                current.name.assign(text, length);
+            } else {
+                current.args.emplace_back(false, std::string_view(text, length));
+                current.capture_ids.push_back(UINT32_MAX);
+            }
+        }
+    }
+    return calls;
+}
+
+} // namespace
+
+struct RuleSet {
+    std::vector<Rule> rules;
+};
+
+static RuleSet build_rule_set(std::string_view source) {
+    const Query &query = shared_query(source);
+    RuleSet set;
+    for (uint32_t pattern = 0; pattern < query.pattern_count(); pattern++) {
+        Rule rule;
+        for (const Call &call : calls_for_pattern(query, pattern)) {
+            auto fail = [&](const std::string &what) {
+                return std::runtime_error("Error: rule " + std::to_string(pattern + 1) + ": " + what);
+            };
+            bool first_is_capture = !call.args.empty() && call.args[0].first;
+            if (call.name == "set!") {
+                if (call.args.size() == 2 && call.args[0].second == "message" && !call.args[1].first) {
+                    rule.message = std::string(call.args[1].second);
+                }
+                continue;
+            }
+            Predicate predicate;
+            if (call.name == "eq?" || call.name == "not-eq?") {
+                if (call.args.size() != 2 || !first_is_capture) throw fail("#" + call.name + " takes a capture and a value");
+                predicate.kind = call.name == "eq?" ? Predicate::Eq : Predicate::NotEq;
+                if (call.args[1].first) predicate.other_capture = call.capture_ids[1];
+                else predicate.values.emplace_back(call.args[1].second);
+            } else if (call.name == "match?" || call.name == "not-match?") {
+                if (call.args.size() != 2 || !first_is_capture || call.args[1].first) {
+                    throw fail("#" + call.name + " takes a capture and a regular expression");
+                }
+                predicate.kind = call.name == "match?" ? Predicate::Match : Predicate::NotMatch;
+                predicate.pattern = std::regex(std::string(call.args[1].second), std::regex::ECMAScript | std::regex::optimize);
+            } else if (call.name == "any-of?") {
+                if (call.args.size() < 2 || !first_is_capture) throw fail("#any-of? takes a capture and values");
+                predicate.kind = Predicate::AnyOf;
+                for (size_t i = 1; i < call.args.size(); i++) predicate.values.emplace_back(call.args[i].second);
+            } else {
+                throw fail("unsupported predicate #" + call.name);
+            }
+            predicate.capture = call.capture_ids[0];
+            rule.predicates.push_back(std::move(predicate));
+        }
+        set.rules.push_back(std::move(rule));
+    }
+    return set;
+}
+
+// Rules are compiled and their predicates parsed (regexes included) once per
+// distinct source, like the queries themselves.
+static const RuleSet &shared_rule_set(std::string_view source) {
+    static std::mutex mutex;
+    static std::map<std::string, std::unique_ptr<RuleSet>, std::less<>> sets;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = sets.find(source);
+    if (it == sets.end()) {
+        auto set = std::make_unique<RuleSet>(build_rule_set(source));
+        it = sets.emplace(std::string(source), std::move(set)).first;
+    }
+    return *it->second;
+}
+
+RuleChecker::RuleChecker(std::string_view rules, AnalysisResult &result)
+    : source_(rules), query_(shared_query(rules)), rules_(shared_rule_set(rules)), result_(result) {}
+
+std::vector<TSSymbol> RuleChecker::subscriptions(const CppGrammar &) const {
+    return {};
+}
+
+static bool satisfied(const Predicate &predicate, const QueryMatch &match, std::string_view code) {
+    std::string_view text = node_text(match.capture(predicate.capture), code);
+    switch (predicate.kind) {
+        case Predicate::Eq:
+        case Predicate::NotEq: {
+            std::string_view other = predicate.other_capture != UINT32_MAX
+                                         ? node_text(match.capture(predicate.other_capture), code)
+                                         : std::string_view(predicate.values[0]);
+            return (text == other) == (predicate.kind == Predicate::Eq);
+        }
+        case Predicate::Match:
+        case Predicate::NotMatch:
+            return std::regex_search(text.begin(), text.end(), predicate.pattern) == (predicate.kind == Predicate::Match);
+        case Predicate::AnyOf:
+            return std::find(predicate.values.begin(), predicate.values.end(), text) != predicate.values.end();
+    }
+    return false;
+}
+
+Visit RuleChecker::match(const QueryMatch &match) {
+    const Rule &rule = rules_.rules[match.pattern];
+    for (const Predicate &predicate : rule.predicates) {
+        if (!satisfied(predicate, match, code_)) return Visit::Continue;
+    }
+
+    if (rule.message.empty()) {
+        std::string warning = "Rule " + std::to_string(match.pattern + 1) + " matched";
+        if (match.capture_count > 0) warning += ": " + std::string(node_text(match.captures[0].node, code_));
+        result_.add_warning(warning);
+        return Visit::Continue;
+    }
+    std::string warning;
+    std::string_view message = rule.message;
+    for (size_t open; (open = message.find('{')) != std::string_view::npos;) {
+        size_t close = message.find('}', open);
+        if (close == std::string_view::npos) break;
+        warning.append(message.substr(0, open));
+        uint32_t id = query_.capture_id(message.substr(open + 1, close - open - 1));
+        if (id == UINT32_MAX) warning.append(message.substr(open, close - open + 1));
+        else warning.append(node_text(match.capture(id), code_));
+        message.remove_prefix(close + 1);
+    }
+    warning.append(message);
+    result_.add_warning(warning);
+    return Visit::Continue;
+}
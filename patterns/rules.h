@@ -0,0 +1,34 @@
+#pragma once
+#include "common.h"
+#include "analyzer.h"
+
+struct RuleSet;
+
+// User rules: tree-sitter query patterns loaded at run time, one warning per
+// match, so a new check needs a query file, not a rebuild. Each pattern's
+// warning text comes from a `(#set! message "...")` directive, in which
+// `{name}` is replaced by the text of capture @name; without one the warning
+// names the rule and quotes the first capture. Matches must also satisfy the
+// pattern's #eq?, #not-eq?, #match?, #not-match? and #any-of? predicates.
+//
+//   ((call_expression function: (identifier) @f) @call
+//    (#any-of? @f "gets" "strcpy")
+//    (#set! message "Unsafe call to {f}"))
+class RuleChecker : public Checker {
+public:
+    // Throws std::runtime_error if `rules` does not compile or uses an
+    // unsupported predicate. The text must outlive the checker.
+    RuleChecker(std::string_view rules, AnalysisResult &result);
+
+    std::vector<TSSymbol> subscriptions(const CppGrammar &g) const override;
+    std::string_view query() const override { return source_; }
+    void begin(std::string_view code) override { code_ = code; }
+    Visit match(const QueryMatch &match) override;
+
+private:
+    std::string_view source_;
+    const Query &query_;
+    const RuleSet &rules_;
+    AnalysisResult &result_;
+    std::string_view code_;
+};
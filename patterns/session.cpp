@@ -0,0 +1,295 @@
+#include "session.h"
+#include "returnv.h"
+#include "rules.h"
+#include "source.h"
+#include "instrument.h"
+#include <stdexcept>
+
+// Row/column of `byte` in `text`.
+static TSPoint point_at(const std::string &text, uint32_t byte) {
+    TSPoint point = {0, 0};
+    const char *line = text.data();
+    const char *end = text.data() + byte;
+    for (const char *p = line; (p = static_cast<const char *>(memchr(p, '\n', end - p))) != nullptr; ++p) {
+        point.row++;
+        line = p + 1;
+    }
+    point.column = static_cast<uint32_t>(end - line);
+    return point;
+}
+
+// `start` advanced over `text`.
+static TSPoint advance(TSPoint start, const std::string &text) {
+    TSPoint point = start;
+    size_t last_newline = text.rfind('\n');
+    if (last_newline == std::string::npos) {
+        point.column += static_cast<uint32_t>(text.size());
+        return point;
+    }
+    point.row += static_cast<uint32_t>(std::count(text.begin(), text.end(), '\n'));
+    point.column = static_cast<uint32_t>(text.size() - last_newline - 1);
+    return point;
+}
+
+static bool intersects(const std::vector<std::pair<uint32_t, uint32_t>> &ranges, uint32_t start, uint32_t end) {
+    for (const auto &[range_start, range_end] : ranges) {
+        if (range_start <= end && start <= range_end) return true;
+    }
+    return false;
+}
+
+struct UnitNode {
+    TSNode node;
+    std::string scope; // names of the enclosing namespaces, each followed by "::"
+};
+
+// Top-level declarations, looking through namespace bodies: the granularity
+// at which per-declaration results are cached. A unit's namespaces are kept
+// with it, since renaming one changes what is inside without touching it.
+// With an empty `code` (an old tree whose text is gone) scopes stay empty.
+static std::vector<UnitNode> top_level_units(TSNode root, std::string_view code) {
+    const CppGrammar &g = cpp_grammar();
+    std::vector<UnitNode> units;
+    std::string scope;
+    std::vector<size_t> scope_sizes;
+    TreeWalker walker;
+    walker.walk(root, [&](TSNode node, uint32_t depth) {
+        TSSymbol symbol = ts_node_symbol(node);
+        if (symbol == g.namespace_definition) {
+            scope_sizes.push_back(scope.size());
+            TSNode name = ts_node_child_by_field_id(node, g.field_name);
+            if (!ts_node_is_null(name) && !code.empty()) scope.append(node_text(name, code)).append("::");
+            return Visit::Continue;
+        }
+        if (depth == 0 || symbol == g.declaration_list) return Visit::Continue;
+        units.push_back({node, scope});
+        return Visit::SkipChildren;
+    }, [&](TSNode node, uint32_t) {
+        if (ts_node_symbol(node) != g.namespace_definition) return;
+        scope.resize(scope_sizes.back());
+        scope_sizes.pop_back();
+    });
+    return units;
+}
+
+AnalysisSession::AnalysisSession(const AnalysisOptions &options, ParserPool *pool)
+    : options_(options), own_pool_(pool ? nullptr : new ParserPool(1)), pool_(pool ? pool : own_pool_.get()) {}
+
+AnalysisSession::~AnalysisSession() {
+    for (auto &[path, file] : files_) {
+        if (file.tree) ts_tree_delete(file.tree);
+    }
+}
+
+const AnalysisResult &AnalysisSession::update(const std::string &path, std::string_view code) {
+    auto it = files_.find(path);
+    if (it == files_.end() || !it->second.tree) {
+        // New, or its first parse ran out of time: nothing to reuse.
+        FileState &file = files_[path];
+        file.code.assign(code);
+        analyze_fresh(file);
+        return file.merged;
+    }
+
+    std::string_view old_code = it->second.code;
+    size_t common = std::min(old_code.size(), code.size());
+    size_t prefix = std::mismatch(old_code.begin(), old_code.begin() + common, code.begin()).first - old_code.begin();
+    if (prefix == old_code.size() && prefix == code.size()) {
+        // Unchanged, but a reparse that ran out of time is still owed.
+        if (!it->second.pending.empty()) return apply(path, {});
+        last_reanalyzed_ = 0;
+        return it->second.merged;
+    }
+    size_t suffix = 0;
+    while (suffix < common - prefix && old_code[old_code.size() - 1 - suffix] == code[code.size() - 1 - suffix]) {
+        suffix++;
+    }
+    TextEdit edit{static_cast<uint32_t>(prefix), static_cast<uint32_t>(old_code.size() - suffix),
+                  std::string(code.substr(prefix, code.size() - suffix - prefix))};
+    return apply(path, {edit});
+}
+
+const AnalysisResult &AnalysisSession::apply(const std::string &path, const std::vector<TextEdit> &edits) {
+    auto it = files_.find(path);
+    if (it == files_.end()) {
+        throw std::runtime_error("Error: " + path + " has not been analyzed in this session");
+    }
+    FileState &file = it->second;
+    for (const TextEdit &edit : edits) {
+        if (edit.start_byte > edit.old_end_byte || edit.old_end_byte > file.code.size()) {
+            throw std::out_of_range("Error: edit outside of " + path);
+        }
+    }
+    if (!file.tree) {
+        for (const TextEdit &edit : edits) {
+            file.code.replace(edit.start_byte, edit.old_end_byte - edit.start_byte, edit.text);
+        }
+        analyze_fresh(file);
+        return file.merged;
+    }
+
+    // Edited spans in the coordinates of the final text, starting with those
+    // of edits whose reparse ran out of time.
+    std::vector<std::pair<uint32_t, uint32_t>> affected = std::move(file.pending);
+    file.pending.clear();
+    for (const TextEdit &edit : edits) {
+        TSInputEdit input;
+        input.start_byte = edit.start_byte;
+        input.old_end_byte = edit.old_end_byte;
+        input.new_end_byte = edit.start_byte + static_cast<uint32_t>(edit.text.size());
+        input.start_point = point_at(file.code, edit.start_byte);
+        input.old_end_point = point_at(file.code, edit.old_end_byte);
+        input.new_end_point = advance(input.start_point, edit.text);
+        ts_tree_edit(file.tree, &input);
+        file.code.replace(edit.start_byte, edit.old_end_byte - edit.start_byte, edit.text);
+
+        for (auto &[start, end] : affected) {
+            if (start >= input.old_end_byte) {
+                start = start - input.old_end_byte + input.new_end_byte;
+                end = end - input.old_end_byte + input.new_end_byte;
+            } else if (end >= input.start_byte) {
+                start = std::min(start, input.start_byte);
+                end = end > input.old_end_byte ? end - input.old_end_byte + input.new_end_byte : input.new_end_byte;
+            }
+        }
+        affected.emplace_back(input.start_byte, input.new_end_byte);
+    }
+
+    if (Metrics *metrics = current_metrics()) metrics->bytes += file.code.size();
+    TSTree *new_tree;
+    {
+        PhaseTimer timer(phase_parse);
+        new_tree = parse_source(pool_->acquire(), file.tree, file.code);
+    }
+    if (!new_tree) {
+        // The edited old tree still matches file.code, so the next update
+        // reparses from it; until then the previous results are all there is.
+        file.pending = std::move(affected);
+        file.merged.incomplete = "parse exceeded the time budget";
+        last_reanalyzed_ = 0;
+        return file.merged;
+    }
+    uint32_t count = 0;
+    TSRange *changed = ts_tree_get_changed_ranges(file.tree, new_tree, &count);
+    for (uint32_t i = 0; i < count; i++) {
+        affected.emplace_back(changed[i].start_byte, changed[i].end_byte);
+    }
+    free(changed);
+
+    reanalyze(file, new_tree, affected);
+    return file.merged;
+}
+
+void AnalysisSession::forget(const std::string &path) {
+    auto it = files_.find(path);
+    if (it == files_.end()) return;
+    if (it->second.tree) ts_tree_delete(it->second.tree);
+    files_.erase(it);
+}
+
+void AnalysisSession::analyze_fresh(FileState &file) {
+    strings_.clear();
+    if (Metrics *metrics = current_metrics()) metrics->bytes += file.code.size();
+    {
+        PhaseTimer timer(phase_parse);
+        file.tree = parse_source(pool_->acquire(), nullptr, file.code);
+    }
+    file.units.clear();
+    file.pending.clear();
+    if (!file.tree) {
+        file.memory = AnalysisResult();
+        file.merged = AnalysisResult();
+        file.merged.incomplete = "parse exceeded the time budget";
+        last_reanalyzed_ = 0;
+        return;
+    }
+    for (UnitNode &unit : top_level_units(ts_tree_root_node(file.tree), file.code)) {
+        AnalysisResult result = analyze_unit(unit.node, file.code, unit.scope);
+        file.units.push_back({ts_node_start_byte(unit.node), ts_node_end_byte(unit.node), std::move(unit.scope), std::move(result)});
+    }
+    last_reanalyzed_ = file.units.size();
+    analyze_memory(file);
+    merge(file);
+}
+
+void AnalysisSession::reanalyze(FileState &file, TSTree *new_tree,
+                                const std::vector<std::pair<uint32_t, uint32_t>> &affected) {
+    // The old tree has been through ts_tree_edit, so its unit positions are
+    // already in new-text coordinates and line up with untouched new units.
+    std::vector<UnitNode> old_units = top_level_units(ts_tree_root_node(file.tree), std::string_view());
+    std::vector<Unit> units;
+    strings_.clear();
+    size_t old_index = 0;
+    last_reanalyzed_ = 0;
+    for (UnitNode &unit : top_level_units(ts_tree_root_node(new_tree), file.code)) {
+        uint32_t start = ts_node_start_byte(unit.node);
+        uint32_t end = ts_node_end_byte(unit.node);
+        while (old_index < old_units.size() && ts_node_start_byte(old_units[old_index].node) < start) old_index++;
+        bool reusable = !intersects(affected, start, end) && old_index < old_units.size() &&
+                        ts_node_start_byte(old_units[old_index].node) == start &&
+                        ts_node_end_byte(old_units[old_index].node) == end && old_index < file.units.size() &&
+                        file.units[old_index].scope == unit.scope;
+        if (reusable) {
+            units.push_back({start, end, std::move(unit.scope), std::move(file.units[old_index].result)});
+        } else {
+            AnalysisResult result = analyze_unit(unit.node, file.code, unit.scope);
+            units.push_back({start, end, std::move(unit.scope), std::move(result)});
+            last_reanalyzed_++;
+        }
+    }
+
+    file.units = std::move(units);
+    ts_tree_delete(file.tree);
+    file.tree = new_tree;
+    if (!affected.empty()) analyze_memory(file);
+    merge(file);
+}
+
+AnalysisResult AnalysisSession::analyze_unit(TSNode unit, std::string_view code, const std::string &scope) {
+    AnalysisResult result;
+    CheckerPipeline pipeline;
+    FunctionChecker functions(result.functions, &strings_);
+    ReturnValueChecker returns(options_.return_function, result.return_values);
+    ReturnSummaryChecker summaries(result.return_summaries, scope);
+    if (options_.functions) pipeline.add(functions);
+    if (!options_.return_function.empty()) pipeline.add(returns);
+    if (options_.return_summaries) pipeline.add(summaries);
+    pipeline.run(unit, code);
+    return result;
+}
+
+// Memory heuristics and user rules run together over the whole file so their
+// warnings interleave exactly as in a single fused run.
+void AnalysisSession::analyze_memory(FileState &file) {
+    file.memory = AnalysisResult();
+    if (!options_.memory && options_.rules.empty()) return;
+    CheckerPipeline pipeline;
+    MemoryChecker memory(file.memory, &strings_);
+    std::unique_ptr<RuleChecker> rules;
+    if (options_.memory) pipeline.add(memory);
+    if (!options_.rules.empty()) {
+        rules = std::make_unique<RuleChecker>(options_.rules, file.memory);
+        pipeline.add(*rules);
+    }
+    pipeline.run(ts_tree_root_node(file.tree), file.code);
+}
+
+// Reassembles the whole-file result in the same order a single fused run
+// would have produced it.
+void AnalysisSession::merge(FileState &file) {
+    file.merged = AnalysisResult();
+    file.merged.warnings = file.memory.warnings;
+    FunctionTable functions(file.merged.functions, &strings_);
+    for (const Unit &unit : file.units) {
+        for (const FunctionInfo &info : unit.result.functions) {
+            functions.add(info.name, info.declaration);
+        }
+        if (file.merged.return_values.empty()) {
+            file.merged.return_values = unit.result.return_values;
+        }
+        file.merged.return_summaries.insert(file.merged.return_summaries.end(), unit.result.return_summaries.begin(),
+                                            unit.result.return_summaries.end());
+    }
+    // Units are in source order, so overloads split across them stay in order.
+    sort_return_summaries(file.merged.return_summaries);
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include "common.h"
+#include "analyzer.h"
+#include "parser_pool.h"
+#include <map>
+
+// One replacement in a file, in bytes of the text it applies to:
+// [start_byte, old_end_byte) is replaced by `text`.
+struct TextEdit {
+    uint32_t start_byte;
+    uint32_t old_end_byte;
+    std::string text;
+};
+
+// Keeps every analyzed file's syntax tree and results between runs so that a
+// changed file is reparsed incrementally (ts_tree_edit + the old tree) and only
+// the analyses touched by the change are redone.
+//
+// Results of the function-table and return-value checkers depend only on the
+// top-level declaration they come from, so they are cached per top-level node
+// and recomputed only for declarations that intersect a range reported by
+// ts_tree_get_changed_ranges (or the edited bytes themselves). The memory
+// checker reasons across the whole file and is rerun on the new tree whenever
+// anything changed, together with any user rules; it never needs a reparse.
+//
+// A session is not thread-safe; use one per thread. Parsers are borrowed from
+// `pool` for each reparse, so sessions can share one; without a pool the
+// session keeps a private one.
+class AnalysisSession {
+public:
+    explicit AnalysisSession(const AnalysisOptions &options = AnalysisOptions(), ParserPool *pool = nullptr);
+    ~AnalysisSession();
+    AnalysisSession(const AnalysisSession &) = delete;
+    AnalysisSession &operator=(const AnalysisSession &) = delete;
+
+    // Analyzes `code` as the current contents of `path`. A path seen before is
+    // diffed against its previous contents (common prefix and suffix) and the
+    // differing span is applied as a single edit.
+    const AnalysisResult &update(const std::string &path, std::string_view code);
+
+    // Applies `edits` in order, each relative to the text left by the previous
+    // one, to a file already in the session, then reparses once.
+    const AnalysisResult &apply(const std::string &path, const std::vector<TextEdit> &edits);
+
+    // Drops a file's tree and cached results.
+    void forget(const std::string &path);
+
+    // Number of top-level declarations reanalyzed by the last update/apply.
+    size_t last_reanalyzed() const { return last_reanalyzed_; }
+
+private:
+    struct Unit {
+        uint32_t start_byte;
+        uint32_t end_byte;
+        std::string scope; // enclosing namespaces, as a "a::b::" prefix
+        AnalysisResult result;
+    };
+
+    struct FileState {
+        std::string code;
+        TSTree *tree = nullptr;
+        std::vector<Unit> units;
+        AnalysisResult memory;
+        AnalysisResult merged;
+        // Edited spans (current coordinates) of a reparse that ran out of
+        // time; `tree` is the edited old tree and is null if the first parse did.
+        std::vector<std::pair<uint32_t, uint32_t>> pending;
+    };
+
+    void analyze_fresh(FileState &file);
+    void reanalyze(FileState &file, TSTree *new_tree, const std::vector<std::pair<uint32_t, uint32_t>> &affected);
+    AnalysisResult analyze_unit(TSNode unit, std::string_view code, const std::string &scope);
+    void analyze_memory(FileState &file);
+    void merge(FileState &file);
+
+    AnalysisOptions options_;
+    std::unique_ptr<ParserPool> own_pool_;
+    ParserPool *pool_;
+    // Shared by the checkers of one update; ids never outlive it, so it is
+    // cleared (keeping its arena) at the start of the next one.
+    StringInterner strings_;
+    std::map<std::string, FileState> files_;
+    size_t last_reanalyzed_ = 0;
+};
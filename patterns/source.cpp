@@ -0,0 +1,169 @@
+#include "source.h"
+#include "budget.h"
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Largest window handed to tree-sitter per read callback.
+static const uint32_t source_chunk_size = 1 << 16;
+
+static void check_size(const std::string &path, uint64_t size) {
+    if (size > std::numeric_limits<uint32_t>::max()) {
+        throw std::runtime_error("Error: File too large for tree-sitter (over 4 GiB): " + path);
+    }
+}
+
+SourceFile::SourceFile(const std::string &path) : path_(path) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Error: Cannot open file " + path);
+    }
+    LARGE_INTEGER size;
+    if (GetFileType(file) == FILE_TYPE_DISK && GetFileSizeEx(file, &size)) {
+        check_size(path, static_cast<uint64_t>(size.QuadPart));
+        if (size.QuadPart > 0) {
+            HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            const void *view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+            if (mapping) CloseHandle(mapping);
+            if (view) {
+                data_ = static_cast<const char *>(view);
+                size_ = static_cast<size_t>(size.QuadPart);
+                mapped_ = true;
+            }
+        }
+        CloseHandle(file);
+        if (mapped_ || size.QuadPart == 0) return;
+    } else {
+        CloseHandle(file);
+    }
+#else
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Error: Cannot open file " + path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        check_size(path, static_cast<uint64_t>(st.st_size));
+        if (st.st_size > 0) {
+            void *map = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (map != MAP_FAILED) {
+                madvise(map, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+                data_ = static_cast<const char *>(map);
+                size_ = static_cast<size_t>(st.st_size);
+                mapped_ = true;
+            }
+        }
+        close(fd);
+        if (mapped_ || st.st_size == 0) return;
+    } else {
+        close(fd);
+    }
+#endif
+    // Not mappable: fall back to reading the stream.
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Error: Cannot open file " + path);
+    }
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    buffer_ = ss.str();
+    check_size(path, buffer_.size());
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+}
+
+SourceFile::~SourceFile() {
+    unmap();
+}
+
+SourceFile::SourceFile(SourceFile &&other) noexcept {
+    *this = std::move(other);
+}
+
+SourceFile &SourceFile::operator=(SourceFile &&other) noexcept {
+    if (this == &other) return *this;
+    unmap();
+    path_ = std::move(other.path_);
+    mapped_ = other.mapped_;
+    buffer_ = std::move(other.buffer_);
+    data_ = mapped_ ? other.data_ : buffer_.data();
+    size_ = other.size_;
+    other.data_ = "";
+    other.size_ = 0;
+    other.mapped_ = false;
+    return *this;
+}
+
+void SourceFile::unmap() {
+    if (!mapped_) return;
+#ifdef _WIN32
+    UnmapViewOfFile(data_);
+#else
+    munmap(const_cast<char *>(data_), size_);
+#endif
+    mapped_ = false;
+    data_ = "";
+    size_ = 0;
+}
+
+static const char *read_chunk(void *payload, uint32_t byte_index, TSPoint, uint32_t *bytes_read) {
+    const std::string_view &source = *static_cast<const std::string_view *>(payload);
+    if (byte_index >= source.size()) {
+        *bytes_read = 0;
+        return "";
+    }
+    *bytes_read = static_cast<uint32_t>(std::min<size_t>(source.size() - byte_index, source_chunk_size));
+    return source.data() + byte_index;
+}
+
+static bool parse_over_budget(TSParseState *) {
+    return budget_expired();
+}
+
+TSTree *parse_source(TSParser *parser, const TSTree *old_tree, std::string_view source) {
+    TSInput input = {&source, read_chunk, TSInputEncodingUTF8, nullptr};
+    TSParseOptions options = {nullptr, parse_over_budget};
+    TSTree *tree = ts_parser_parse_with_options(parser, old_tree, input, options);
+    // A cancelled parser would try to resume on its next call; start over instead.
+    if (!tree) ts_parser_reset(parser);
+    return tree;
+}
+
+static bool is_cpp_source(const std::filesystem::path &path) {
+    static const std::set<std::string> extensions = {
+        ".c", ".cc", ".cpp", ".cxx", ".c++", ".h", ".hh", ".hpp", ".hxx", ".h++", ".ipp", ".inl", ".tpp"
+    };
+    return extensions.count(path.extension().string()) != 0;
+}
+
+std::vector<std::string> collect_sources(const std::vector<std::string> &operands) {
+    std::vector<std::string> files;
+    for (const std::string &operand : operands) {
+        std::filesystem::path path(operand);
+        if (!std::filesystem::is_directory(path)) {
+            files.push_back(operand);
+            continue;
+        }
+        std::vector<std::string> found;
+        for (const auto &entry : std::filesystem::recursive_directory_iterator(
+                 path, std::filesystem::directory_options::skip_permission_denied)) {
+            if (entry.is_regular_file() && is_cpp_source(entry.path())) {
+                found.push_back(entry.path().string());
+            }
+        }
+        std::sort(found.begin(), found.end());
+        files.insert(files.end(), found.begin(), found.end());
+    }
+    return files;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include "common.h"
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A source file mapped read-only into memory. Nothing is read up front and
+// nothing is copied: tree-sitter pulls the text through parse_source() and node
+// text is served by node_text() as views into the mapping, so the pages stay
+// file-backed and the kernel can drop them under memory pressure. Non-regular
+// files (pipes, /dev/stdin) cannot be mapped and are read into an owned buffer.
+//
+// Throws std::runtime_error if the file cannot be opened, or if it is larger
+// than the 4 GiB tree-sitter can address with its 32-bit byte offsets.
+class SourceFile {
+public:
+    SourceFile() = default; // empty text
+    explicit SourceFile(const std::string &path);
+    ~SourceFile();
+    SourceFile(SourceFile &&other) noexcept;
+    SourceFile &operator=(SourceFile &&other) noexcept;
+    SourceFile(const SourceFile &) = delete;
+    SourceFile &operator=(const SourceFile &) = delete;
+
+    std::string_view text() const { return std::string_view(data_, size_); }
+    const std::string &path() const { return path_; }
+
+private:
+    void unmap();
+
+    std::string path_;
+    const char *data_ = "";
+    size_t size_ = 0;
+    bool mapped_ = false;
+    std::string buffer_; // only for files that cannot be mapped
+};
+
+// Parses `source` through a TSInput read callback that hands tree-sitter
+// bounded windows of the buffer, so a mapped file is consumed in place.
+// Returns null, with the parser reset, if the calling thread's time budget
+// (see budget.h) runs out first.
+TSTree *parse_source(TSParser *parser, const TSTree *old_tree, std::string_view source);
+
+// Expands command line operands into a list of files. Directories are walked
+// recursively and only C/C++ sources are kept; each directory's files are
+// sorted so the report order does not depend on the filesystem.
+std::vector<std::string> collect_sources(const std::vector<std::string> &operands);
@@ -0,0 +1,5 @@
+#pragma once
+
+// Bump whenever a change alters what any analysis reports for the same input:
+// it is part of every result-cache key, so stale cached results stop matching.
+#define CPPREVIEWER_VERSION "0.8.0"
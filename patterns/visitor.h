@@ -0,0 +1,87 @@
+#pragma once
+#include "common.h"
+
+// What a pre-order hook wants the walker to do next.
+enum class Visit {
+    Continue,     // descend into the node's children
+    SkipChildren, // do not descend; the post-order hook still runs
+    Stop,         // abandon the walk, no further hooks run
+};
+
+// Depth-first traversal driven by a TSTreeCursor. Moving a cursor to the first
+// child, the next sibling or the parent is O(1), so a whole walk is linear in
+// the number of nodes, whereas looping over ts_node_child(node, i) is O(i) per
+// call and turns wide nodes quadratic. The cursor also keeps the ancestor path
+// itself, so no frontier vector grows with the tree.
+//
+// `enter(node, depth)` returns a Visit; `leave(node, depth)` runs once the
+// node's subtree is done (also after SkipChildren, never after Stop). Depth is
+// counted from the walk's root, which is 0. A TreeWalker can be reused for many
+// walks; the cursor's internal stack is kept between them.
+class TreeWalker {
+public:
+    TreeWalker() = default;
+    ~TreeWalker() {
+        if (has_cursor_) ts_tree_cursor_delete(&cursor_);
+    }
+    TreeWalker(const TreeWalker &) = delete;
+    TreeWalker &operator=(const TreeWalker &) = delete;
+
+    // Returns false if a hook stopped the walk.
+    template <typename Enter, typename Leave>
+    bool walk(TSNode root, Enter &&enter, Leave &&leave) {
+        if (ts_node_is_null(root)) return true;
+        reset(root);
+        uint32_t depth = 0;
+        for (;;) {
+            TSNode node = ts_tree_cursor_current_node(&cursor_);
+            Visit visit = enter(node, depth);
+            if (visit == Visit::Stop) return false;
+            if (visit == Visit::Continue && ts_tree_cursor_goto_first_child(&cursor_)) {
+                depth++;
+                continue;
+            }
+            leave(node, depth);
+            // Climb until there is a sibling to move to, finishing parents on the way.
+            for (;;) {
+                if (depth == 0) return true;
+                if (ts_tree_cursor_goto_next_sibling(&cursor_)) break;
+                ts_tree_cursor_goto_parent(&cursor_);
+                depth--;
+                leave(ts_tree_cursor_current_node(&cursor_), depth);
+            }
+        }
+    }
+
+    template <typename Enter>
+    bool walk(TSNode root, Enter &&enter) {
+        return walk(root, enter, [](TSNode, uint32_t) {});
+    }
+
+private:
+    void reset(TSNode root) {
+        if (has_cursor_) {
+            ts_tree_cursor_reset(&cursor_, root);
+        } else {
+            cursor_ = ts_tree_cursor_new(root);
+            has_cursor_ = true;
+        }
+    }
+
+    TSTreeCursor cursor_{};
+    bool has_cursor_ = false;
+};
+
+// Calls `fn(child)` for every direct child of `node`, in order, in time linear
+// in the number of children.
+template <typename Fn>
+void for_each_child(TSNode node, Fn &&fn) {
+    if (ts_node_is_null(node)) return;
+    TSTreeCursor cursor = ts_tree_cursor_new(node);
+    if (ts_tree_cursor_goto_first_child(&cursor)) {
+        do {
+            fn(ts_tree_cursor_current_node(&cursor));
+        } while (ts_tree_cursor_goto_next_sibling(&cursor));
+    }
+    ts_tree_cursor_delete(&cursor);
+}
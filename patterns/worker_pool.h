@@ -0,0 +1,63 @@
+#pragma once
+#include "common.h"
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Number of workers to use when the caller did not ask for a specific count.
+inline unsigned default_worker_count() {
+    unsigned n = std::thread::hardware_concurrency();
+    return n ? n : 1;
+}
+
+// Largest worker count accepted from a command line.
+constexpr unsigned max_worker_count = 1024;
+
+// Parses a -j argument into `jobs`; 0 keeps the default count.
+inline bool parse_worker_count(std::string_view text, unsigned &jobs) {
+    uint64_t value;
+    if (!parse_unsigned(text, max_worker_count, value)) return false;
+    jobs = static_cast<unsigned>(value);
+    return true;
+}
+
+// Runs `work(index, worker)` for every index in [0, count) on `jobs` threads.
+// Indices are handed out one at a time from a shared counter, so a single huge
+// file does not hold back a statically assigned slice of small ones. `worker`
+// is in [0, jobs) and stable for the lifetime of a thread, which lets callers
+// keep one expensive object (a TSParser, a scratch buffer) per worker.
+// The first exception thrown by `work` is rethrown once every thread joined.
+template <typename Fn>
+void parallel_for(size_t count, unsigned jobs, Fn &&work) {
+    if (jobs == 0) jobs = default_worker_count();
+    if (jobs > count) jobs = count ? static_cast<unsigned>(count) : 1;
+
+    std::atomic<size_t> next{0};
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto run = [&](unsigned worker) {
+        for (size_t i = next.fetch_add(1); i < count; i = next.fetch_add(1)) {
+            try {
+                work(i, worker);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error) error = std::current_exception();
+                next.store(count);
+            }
+        }
+    };
+
+    if (jobs == 1) {
+        run(0);
+    } else {
+        std::vector<std::thread> threads;
+        threads.reserve(jobs - 1);
+        for (unsigned w = 1; w < jobs; ++w) threads.emplace_back(run, w);
+        run(0);
+        for (std::thread &t : threads) t.join();
+    }
+    if (error) std::rethrow_exception(error);
+}
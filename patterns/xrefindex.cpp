@@ -0,0 +1,303 @@
+#include "xrefindex.h"
+#include "functions.h"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+static const char xref_magic[4] = {'C', 'P', 'R', 'X'};
+static const uint32_t xref_format = 1;
+static const uint32_t xref_byte_order = 0x01020304;
+static const uint32_t no_container = UINT32_MAX;
+
+const char *xref_kind_name(XrefKind kind) {
+    switch (kind) {
+    case XrefKind::Definition: return "definition";
+    case XrefKind::Declaration: return "declaration";
+    case XrefKind::Call: return "call";
+    }
+    return "unknown";
+}
+
+std::vector<TSSymbol> XrefChecker::subscriptions(const CppGrammar &g) const {
+    return {g.function_definition, g.declaration, g.field_declaration, g.call_expression,
+            g.namespace_definition, g.class_specifier, g.struct_specifier, g.union_specifier};
+}
+
+void XrefChecker::begin(std::string_view code) {
+    code_ = code;
+    prefix_.clear();
+    container_.clear();
+    scopes_.clear();
+}
+
+void XrefChecker::add(XrefKind kind, TSNode node, std::string name) {
+    entries_.push_back({kind, std::move(name), kind == XrefKind::Call ? container_ : std::string(),
+                        ts_node_start_byte(node), ts_node_end_byte(node), ts_node_start_point(node),
+                        ts_node_end_point(node)});
+}
+
+Visit XrefChecker::enter(TSNode node, uint32_t) {
+    const CppGrammar &g = cpp_grammar();
+    TSSymbol type = ts_node_symbol(node);
+
+    if (type == g.call_expression) {
+        std::string callee = callee_name(node, code_);
+        if (!callee.empty()) add(XrefKind::Call, node, std::move(callee));
+        return Visit::Continue;
+    }
+
+    if (type == g.declaration || type == g.field_declaration) {
+        std::string_view name = defined_name(node, code_);
+        if (!name.empty()) add(XrefKind::Declaration, node, prefix_ + std::string(name));
+        return Visit::Continue;
+    }
+
+    scopes_.push_back({node.id, prefix_.size(), container_.size()});
+    if (type == g.function_definition) {
+        std::string name = prefix_ + std::string(defined_name(node, code_));
+        container_ = name;
+        add(XrefKind::Definition, node, std::move(name));
+        return Visit::Continue;
+    }
+
+    // Namespaces and classes qualify what is declared inside them; anonymous
+    // ones add nothing.
+    TSNode name = ts_node_child_by_field_id(node, g.field_name);
+    if (!ts_node_is_null(name)) prefix_.append(node_text(name, code_)).append("::");
+    return Visit::Continue;
+}
+
+void XrefChecker::leave(TSNode node, uint32_t) {
+    if (scopes_.empty() || scopes_.back().id != node.id) return;
+    prefix_.resize(scopes_.back().prefix_size);
+    container_.resize(scopes_.back().container_size);
+    scopes_.pop_back();
+}
+
+std::vector<XrefEntry> collect_xrefs(TSNode node, std::string_view code) {
+    std::vector<XrefEntry> entries;
+    XrefChecker checker(entries);
+    CheckerPipeline pipeline;
+    pipeline.add(checker);
+    pipeline.run(node, code);
+    return entries;
+}
+
+XrefIndex::XrefIndex(const std::string &path) : file_(path) {
+    std::string_view data = file_.text();
+    const XrefHeader *header = reinterpret_cast<const XrefHeader *>(data.data());
+    if (data.size() < sizeof(XrefHeader) || memcmp(header->magic, xref_magic, sizeof(xref_magic)) != 0 ||
+        header->format != xref_format || header->byte_order != xref_byte_order) {
+        throw std::runtime_error("Error: Not a cross-reference index: " + path);
+    }
+    auto fits = [&](uint32_t offset, uint32_t count, size_t size) {
+        return offset % alignof(uint32_t) == 0 && offset <= data.size() && uint64_t(count) * size <= data.size() - offset;
+    };
+    if (!fits(header->files_offset, header->file_count, sizeof(XrefFile)) ||
+        !fits(header->names_offset, header->name_count, sizeof(XrefName)) ||
+        !fits(header->records_offset, header->record_count, sizeof(XrefRecord)) ||
+        !fits(header->strings_offset, header->strings_size, 1)) {
+        throw std::runtime_error("Error: Truncated cross-reference index: " + path);
+    }
+    header_ = header;
+    files_ = reinterpret_cast<const XrefFile *>(data.data() + header->files_offset);
+    names_ = reinterpret_cast<const XrefName *>(data.data() + header->names_offset);
+    records_ = reinterpret_cast<const XrefRecord *>(data.data() + header->records_offset);
+    strings_ = data.data() + header->strings_offset;
+}
+
+std::string_view XrefIndex::string(uint32_t offset, uint32_t size) const {
+    if (!header_ || offset > header_->strings_size || size > header_->strings_size - offset) return std::string_view();
+    return std::string_view(strings_ + offset, size);
+}
+
+std::string_view XrefIndex::file_path(uint32_t file) const {
+    return file < file_count() ? string(files_[file].path_offset, files_[file].path_size) : std::string_view();
+}
+
+ContentHash XrefIndex::file_hash(uint32_t file) const {
+    if (file >= file_count()) return {0, 0};
+    const uint32_t *hash = files_[file].hash;
+    return {uint64_t(hash[1]) << 32 | hash[0], uint64_t(hash[3]) << 32 | hash[2]};
+}
+
+std::string_view XrefIndex::name(uint32_t name) const {
+    return name < name_count() ? string(names_[name].offset, names_[name].size) : std::string_view();
+}
+
+// First index in [first, last) for which `before` is false; `before` must
+// hold on a prefix of the range and nowhere after it.
+template <typename Before>
+static uint32_t partition(uint32_t first, uint32_t last, Before before) {
+    while (first < last) {
+        uint32_t middle = first + (last - first) / 2;
+        if (before(middle)) {
+            first = middle + 1;
+        } else {
+            last = middle;
+        }
+    }
+    return first;
+}
+
+uint32_t XrefIndex::find(std::string_view key) const {
+    uint32_t found = partition(0, name_count(), [&](uint32_t i) { return name(i) < key; });
+    return found < name_count() && name(found) == key ? found : UINT32_MAX;
+}
+
+std::pair<uint32_t, uint32_t> XrefIndex::prefix(std::string_view key) const {
+    uint32_t first = partition(0, name_count(), [&](uint32_t i) { return name(i) < key; });
+    uint32_t last = partition(first, name_count(), [&](uint32_t i) { return name(i).substr(0, key.size()) == key; });
+    return {first, last};
+}
+
+std::pair<const XrefRecord *, const XrefRecord *> XrefIndex::records(uint32_t name) const {
+    if (name >= name_count()) return {nullptr, nullptr};
+    const XrefName &entry = names_[name];
+    if (entry.first_record > record_count() || entry.record_count > record_count() - entry.first_record) {
+        return {nullptr, nullptr};
+    }
+    return {records_ + entry.first_record, records_ + entry.first_record + entry.record_count};
+}
+
+std::pair<const XrefRecord *, const XrefRecord *> XrefIndex::lookup(std::string_view name) const {
+    return records(find(name));
+}
+
+void XrefIndexBuilder::load(const XrefIndex &index) {
+    std::vector<std::vector<XrefEntry>> entries(index.file_count());
+    for (uint32_t name = 0; name < index.name_count(); name++) {
+        auto range = index.records(name);
+        for (const XrefRecord *record = range.first; record != range.second; ++record) {
+            if (record->file >= index.file_count() || record->kind > uint32_t(XrefKind::Call)) continue;
+            std::string container = record->container == no_container ? std::string() : std::string(index.name(record->container));
+            entries[record->file].push_back({static_cast<XrefKind>(record->kind), std::string(index.name(name)),
+                                             std::move(container), record->start_byte, record->end_byte,
+                                             {record->start_row, record->start_column},
+                                             {record->end_row, record->end_column}});
+        }
+    }
+    // Records come grouped by name; put each file's back in source order.
+    for (uint32_t file = 0; file < index.file_count(); file++) {
+        std::stable_sort(entries[file].begin(), entries[file].end(),
+                         [](const XrefEntry &a, const XrefEntry &b) { return a.start_byte < b.start_byte; });
+        set_file(std::string(index.file_path(file)), index.file_hash(file), std::move(entries[file]));
+    }
+}
+
+void XrefIndexBuilder::set_file(const std::string &path, ContentHash hash, std::vector<XrefEntry> entries) {
+    files_[path] = {hash, std::move(entries)};
+}
+
+void XrefIndexBuilder::remove_file(const std::string &path) {
+    files_.erase(path);
+}
+
+bool XrefIndexBuilder::unchanged(const std::string &path, ContentHash hash) const {
+    auto found = files_.find(path);
+    return found != files_.end() && found->second.hash.low == hash.low && found->second.hash.high == hash.high;
+}
+
+std::vector<std::string> XrefIndexBuilder::paths() const {
+    std::vector<std::string> paths;
+    paths.reserve(files_.size());
+    for (const auto &file : files_) paths.push_back(file.first);
+    return paths;
+}
+
+template <typename T>
+static void append(std::string &out, const T &value) {
+    out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static uint32_t checked_size(size_t size) {
+    if (size > UINT32_MAX) throw std::runtime_error("Error: Cross-reference index too large (over 4 GiB)");
+    return static_cast<uint32_t>(size);
+}
+
+// Names are numbered in sorted order; records are placed with a stable
+// counting sort by name, so within a name they keep file and source order.
+void XrefIndexBuilder::write(const std::string &path) const {
+    std::vector<std::string_view> names;
+    for (const auto &file : files_) {
+        for (const XrefEntry &entry : file.second.entries) {
+            names.push_back(entry.name);
+            if (!entry.container.empty()) names.push_back(entry.container);
+        }
+    }
+    std::sort(names.begin(), names.end());
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+    std::unordered_map<std::string_view, uint32_t> name_ids;
+    name_ids.reserve(names.size());
+    for (size_t i = 0; i < names.size(); i++) name_ids.emplace(names[i], static_cast<uint32_t>(i));
+
+    std::vector<uint32_t> first(names.size() + 1, 0);
+    for (const auto &file : files_) {
+        for (const XrefEntry &entry : file.second.entries) first[name_ids[entry.name] + 1]++;
+    }
+    for (size_t i = 0; i < names.size(); i++) first[i + 1] += first[i];
+    std::vector<XrefRecord> records(first.back());
+    std::vector<uint32_t> fill(first.begin(), first.end() - 1);
+    uint32_t file_index = 0;
+    for (const auto &file : files_) {
+        for (const XrefEntry &entry : file.second.entries) {
+            uint32_t name = name_ids[entry.name];
+            uint32_t container = entry.container.empty() ? no_container : name_ids[entry.container];
+            records[fill[name]++] = {name, container, file_index, static_cast<uint32_t>(entry.kind),
+                                     entry.start_byte, entry.end_byte, entry.start.row, entry.start.column,
+                                     entry.end.row, entry.end.column};
+        }
+        file_index++;
+    }
+
+    std::string strings;
+    std::string file_table;
+    for (const auto &file : files_) {
+        const ContentHash &hash = file.second.hash;
+        XrefFile record = {checked_size(strings.size()), checked_size(file.first.size()),
+                           {static_cast<uint32_t>(hash.low), static_cast<uint32_t>(hash.low >> 32),
+                            static_cast<uint32_t>(hash.high), static_cast<uint32_t>(hash.high >> 32)}};
+        append(file_table, record);
+        strings += file.first;
+    }
+    std::string name_table;
+    for (size_t i = 0; i < names.size(); i++) {
+        append(name_table, XrefName{checked_size(strings.size()), checked_size(names[i].size()), first[i], first[i + 1] - first[i]});
+        strings += names[i];
+    }
+
+    XrefHeader header;
+    memcpy(header.magic, xref_magic, sizeof(xref_magic));
+    header.format = xref_format;
+    header.byte_order = xref_byte_order;
+    header.file_count = checked_size(files_.size());
+    header.name_count = checked_size(names.size());
+    header.record_count = checked_size(records.size());
+    header.strings_size = checked_size(strings.size());
+    header.files_offset = sizeof(XrefHeader);
+    header.names_offset = checked_size(header.files_offset + file_table.size());
+    header.records_offset = checked_size(header.names_offset + name_table.size());
+    header.strings_offset = checked_size(header.records_offset + records.size() * sizeof(XrefRecord));
+
+    std::string temp = path + ".tmp" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+    {
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(file_table.data(), static_cast<std::streamsize>(file_table.size()));
+        out.write(name_table.data(), static_cast<std::streamsize>(name_table.size()));
+        out.write(reinterpret_cast<const char *>(records.data()), static_cast<std::streamsize>(records.size() * sizeof(XrefRecord)));
+        out.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+        if (!out.flush()) {
+            std::error_code ignored;
+            std::filesystem::remove(temp, ignored);
+            throw std::runtime_error("Error: Cannot write cross-reference index " + path);
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temp, path, error);
+    if (error) {
+        std::filesystem::remove(temp, error);
+        throw std::runtime_error("Error: Cannot write cross-reference index " + path);
+    }
+}
@@ -0,0 +1,183 @@
+#pragma once
+#include "common.h"
+#include "cache.h"
+#include "checker.h"
+#include "source.h"
+#include <map>
+
+enum class XrefKind : uint32_t {
+    Definition,  // function_definition
+    Declaration, // declaration or member declaration of a function
+    Call,        // call_expression naming a function
+};
+
+const char *xref_kind_name(XrefKind kind);
+
+// One reference as collected from a tree. Ranges are those of the whole
+// definition, declaration or call; rows and columns are zero-based, columns
+// in bytes.
+struct XrefEntry {
+    XrefKind kind;
+    std::string name;      // qualified for definitions and declarations, as written for calls
+    std::string container; // qualified name of the function a call is in; empty elsewhere
+    uint32_t start_byte;
+    uint32_t end_byte;
+    TSPoint start;
+    TSPoint end;
+};
+
+// Collects the function definitions, function declarations and calls of one
+// tree. Names are qualified with the enclosing namespaces and classes, as in
+// ReturnSummaryChecker; calls are recorded with callee_name().
+class XrefChecker : public Checker {
+public:
+    explicit XrefChecker(std::vector<XrefEntry> &entries) : entries_(entries) {}
+
+    std::vector<TSSymbol> subscriptions(const CppGrammar &g) const override;
+    void begin(std::string_view code) override;
+    Visit enter(TSNode node, uint32_t depth) override;
+    void leave(TSNode node, uint32_t depth) override;
+
+private:
+    void add(XrefKind kind, TSNode node, std::string name);
+
+    // A namespace, class or function; `prefix_` and `container_` are cut back
+    // to their sizes from before it when it ends.
+    struct Scope {
+        const void *id;
+        size_t prefix_size;
+        size_t container_size;
+    };
+
+    std::vector<XrefEntry> &entries_;
+    std::string_view code_;
+    std::string prefix_; // innermost namespace or class, with a trailing "::"
+    std::string container_;
+    std::vector<Scope> scopes_;
+};
+
+// Runs an XrefChecker on its own over `node`.
+std::vector<XrefEntry> collect_xrefs(TSNode node, std::string_view code);
+
+// On-disk layout of an index, in native byte order: a header, then the
+// sections it points to. Every record is a run of uint32_t, so each section
+// is 4-byte aligned in a mapping and is read in place.
+//
+//   files    one XrefFile per indexed file, sorted by path
+//   names    one XrefName per distinct name, sorted bytewise
+//   records  all XrefRecords, grouped by name in name order, then by file
+//            and position
+//   strings  the bytes of every path and name
+struct XrefHeader {
+    char magic[4];
+    uint32_t format;
+    uint32_t byte_order; // 0x01020304 as written
+    uint32_t file_count;
+    uint32_t name_count;
+    uint32_t record_count;
+    uint32_t strings_size;
+    uint32_t files_offset;
+    uint32_t names_offset;
+    uint32_t records_offset;
+    uint32_t strings_offset;
+};
+
+struct XrefFile {
+    uint32_t path_offset;
+    uint32_t path_size;
+    uint32_t hash[4]; // ContentHash of the contents indexed, low word first
+};
+
+struct XrefName {
+    uint32_t offset;
+    uint32_t size;
+    uint32_t first_record;
+    uint32_t record_count;
+};
+
+struct XrefRecord {
+    uint32_t name;      // index into names
+    uint32_t container; // index into names; UINT32_MAX outside functions
+    uint32_t file;      // index into files
+    uint32_t kind;      // XrefKind
+    uint32_t start_byte;
+    uint32_t end_byte;
+    uint32_t start_row;
+    uint32_t start_column;
+    uint32_t end_row;
+    uint32_t end_column;
+};
+
+// Read-only view of an index file. Opening maps the file and checks the
+// header and that every section lies inside it, which costs the same for any
+// size of index; records are read straight from the mapping when looked up.
+// Names and records that point outside their sections (a corrupt file) read
+// as empty rather than out of bounds. Replacing the file (XrefIndexBuilder
+// renames a new one into place) leaves open views on the old contents.
+//
+// Throws std::runtime_error if the file cannot be opened or is not an index
+// of this format.
+class XrefIndex {
+public:
+    XrefIndex() = default; // empty index
+    explicit XrefIndex(const std::string &path);
+
+    uint32_t file_count() const { return header_ ? header_->file_count : 0; }
+    uint32_t name_count() const { return header_ ? header_->name_count : 0; }
+    uint32_t record_count() const { return header_ ? header_->record_count : 0; }
+
+    std::string_view file_path(uint32_t file) const;
+    ContentHash file_hash(uint32_t file) const;
+    std::string_view name(uint32_t name) const;
+
+    // Index of `name`, or UINT32_MAX; a binary search over the names.
+    uint32_t find(std::string_view name) const;
+    // Names starting with `prefix`: [first, last) indexes, in name order.
+    std::pair<uint32_t, uint32_t> prefix(std::string_view prefix) const;
+
+    // Records of name `name` (an index), in file and position order.
+    std::pair<const XrefRecord *, const XrefRecord *> records(uint32_t name) const;
+    std::pair<const XrefRecord *, const XrefRecord *> lookup(std::string_view name) const;
+
+private:
+    std::string_view string(uint32_t offset, uint32_t size) const;
+
+    SourceFile file_;
+    const XrefHeader *header_ = nullptr;
+    const XrefFile *files_ = nullptr;
+    const XrefName *names_ = nullptr;
+    const XrefRecord *records_ = nullptr;
+    const char *strings_ = nullptr;
+};
+
+// Builds and rewrites index files. Start from an existing index with load(),
+// replace the entries of changed files with set_file() and write() the
+// result; only those files need parsing. Writing is linear in the number of
+// entries plus a sort of the distinct names.
+class XrefIndexBuilder {
+public:
+    // Adds every file of `index`, replacing files already present.
+    void load(const XrefIndex &index);
+
+    void set_file(const std::string &path, ContentHash hash, std::vector<XrefEntry> entries);
+    void remove_file(const std::string &path);
+
+    // True when `path` is present and was indexed from contents with `hash`.
+    bool unchanged(const std::string &path, ContentHash hash) const;
+
+    // Paths of every file, sorted.
+    std::vector<std::string> paths() const;
+
+    // Writes the index to a temporary file next to `path` and renames it into
+    // place, so readers see either the old index or the new one. Throws
+    // std::runtime_error when it cannot be written.
+    void write(const std::string &path) const;
+
+private:
+    struct FileEntries {
+        ContentHash hash;
+        std::vector<XrefEntry> entries;
+    };
+
+    std::map<std::string, FileEntries> files_;
+};
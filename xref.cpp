@@ -1,162 +1,229 @@
-#include <tree_sitter/api.h>
-#include <iostream>
+#include "patterns/cache.h"
+#include "patterns/functions.h"
+#include "patterns/instrument.h"
+#include "patterns/source.h"
+#include "patterns/worker_pool.h"
+#include "patterns/xrefindex.h"
+#include <filesystem>
 #include <fstream>
-#include <sstream>
-#include <unordered_map>
-#include <vector>
-#include <set>
-#include <iomanip>
-#include <algorithm>
-#include <string.h>
-extern "C" const TSLanguage *tree_sitter_cpp();
 
-// Read file content into a string
-std::string read_file(const std::string &path) {
-    std::ifstream in(path);
-    std::ostringstream ss;
-    ss << in.rdbuf();
-    return ss.str();
-}
-std::string ts_node_string(TSNode node, const std::string& code){
-    size_t start_byte = ts_node_start_byte(node);
-    size_t end_byte = ts_node_end_byte(node);
-    return code.substr(start_byte, end_byte - start_byte);
-}
-
-std::string find_identifier(TSNode node, const std::string& code) {
-    if (std::string(ts_node_type(node)) == "identifier")
-        return ts_node_string(node, code);
-    uint32_t count = ts_node_child_count(node);
-    for (uint32_t i = 0; i < count; ++i) {
-        TSNode child = ts_node_child(node, i);
-        std::string name = find_identifier(child, code);
-        if (!name.empty())
-            return name;
-    }
-    return "";
-}
-
-// Struct to hold collected function information
-struct FunctionInfo {
-    std::string name;
-    std::string declaration;
-};
-
-// Recursively traverses the syntax tree to collect functions.
-// It checks several node types: "template_declaration", "function_definition",
-// "declaration", and "function_declaration" to extract the function name
-// and its associated declaration text.
-void collect_functions(TSNode node, const std::string& code, std::vector<FunctionInfo>& functions) {
-    std::string node_type = ts_node_type(node);
-    if (node_type=="field_declaration"){
-        if (ts_node_child_count(node) <=2) return;
-        TSNode primitive_type = ts_node_child(node, 0),
-               declarator = ts_node_child(node, 1);
-        if (!strcmp(ts_node_type(primitive_type), "primitive_type") &&
-            !strcmp(ts_node_type(declarator), "function_declarator")) {
-            std::string function_name = ts_node_string(ts_node_child(declarator, 0), code);
-            std::string declaration_text= ts_node_string(node, code);
-            auto it = std::find_if(functions.begin(), functions.end(), [&function_name, &declaration_text](const FunctionInfo& info) {
-                return info.name == function_name&& info.declaration == declaration_text;//yes of course templates
-            });
-            if (it == functions.end()) {
-                FunctionInfo info;
-                info.name = function_name;
-                info.declaration = declaration_text;
-                functions.push_back(info);
-            }
+// Brings the index at `index_path` up to date with `operands`: files whose
+// contents hash the same as when they were indexed are skipped, the others
+// are parsed (on `jobs` threads) and replace their old entries, and indexed
+// files that no longer exist are dropped. Other indexed files are kept, so a
+// single edited file can be passed on its own.
+static void update_index(const std::string &index_path, const std::vector<std::string> &operands, unsigned jobs) {
+    XrefIndexBuilder builder;
+    if (std::filesystem::exists(index_path)) {
+        try {
+            builder.load(XrefIndex(index_path));
+        } catch (const std::exception &e) {
+            std::cerr << e.what() << "; rebuilding\n";
         }
     }
-    if ((node_type == "function_definition" || node_type == "function_declaration")) { // found a declarator & likely a function
-        std::string function_name = find_identifier(node, code);
-        std::string declaration_text;
-        if (node_type == "function_definition") {
-            TSNode primitive_type = ts_node_child(node, 0);
-            if (!strcmp(ts_node_type(primitive_type), "function_declarator")) {
-                if (ts_node_child_count(primitive_type) > 0&&
-                    !strcmp(ts_node_type(ts_node_child(primitive_type, 0)), "destructor_name"))
-                        function_name=ts_node_string(ts_node_child(primitive_type, 0), code);
-                size_t start_byte = ts_node_start_byte(primitive_type);
-                size_t end_byte = ts_node_end_byte(primitive_type);
-                declaration_text = code.substr(start_byte, end_byte - start_byte) + ";";
-                goto fine;
-            }
-            else{
-                TSNode func_decl = ts_node_child(node, 1);
-                if (!strcmp(ts_node_type(func_decl), "function_declarator")) {
-                    if (ts_node_child_count(func_decl) > 1 &&
-                        !strcmp(ts_node_type(ts_node_child(func_decl, 0)), "field_identifier"))
-                        function_name = ts_node_string(ts_node_child(func_decl, 0), code);
-                }
-                size_t start_byte = ts_node_start_byte(primitive_type);
-                size_t end_byte = ts_node_end_byte(func_decl);
-                declaration_text = code.substr(start_byte, end_byte - start_byte) + ";";
+    for (const std::string &path : builder.paths()) {
+        if (!std::filesystem::exists(path)) builder.remove_file(path);
+    }
+
+    std::vector<std::string> files = collect_sources(operands);
+    struct Update {
+        bool changed = false;
+        ContentHash hash = {0, 0};
+        std::vector<XrefEntry> entries;
+        std::string error;
+    };
+    std::vector<Update> updates(files.size());
+    if (jobs == 0) jobs = default_worker_count();
+    size_t workers = std::min<size_t>(jobs, std::max<size_t>(files.size(), 1));
+    std::vector<TSParser *> parsers(workers);
+    for (TSParser *&parser : parsers) {
+        parser = ts_parser_new();
+        ts_parser_set_language(parser, tree_sitter_cpp());
+    }
+    parallel_for(files.size(), static_cast<unsigned>(workers), [&](size_t index, unsigned worker) {
+        Update &update = updates[index];
+        try {
+            SourceFile source(files[index]);
+            update.hash = content_hash(source.text());
+            if (builder.unchanged(files[index], update.hash)) return;
+            TSTree *tree = parse_source(parsers[worker], nullptr, source.text());
+            if (!tree) {
+                update.error = "Error: could not parse " + files[index];
+                return;
             }
+            update.entries = collect_xrefs(ts_tree_root_node(tree), source.text());
+            update.changed = true;
+            ts_tree_delete(tree);
+        } catch (const std::exception &e) {
+            update.error = e.what();
         }
-        fine:
-        auto it = std::find_if(functions.begin(), functions.end(), [&function_name, &declaration_text](const FunctionInfo& info) {
-            return info.name == function_name&& info.declaration == declaration_text;//yes of course templates
-        });
-        if (it == functions.end()) {
-            FunctionInfo info;
-            info.name = function_name;
-            info.declaration = declaration_text;
-            functions.push_back(info);
-        }
+    });
+    for (TSParser *parser : parsers) {
+        ts_parser_delete(parser);
     }
-    
-    // Recurse into children
-    uint32_t total_children = ts_node_child_count(node);
-    for (uint32_t i = 0; i < total_children; ++i) {
-        TSNode child = ts_node_child(node, i);
-        collect_functions(child, code, functions);
+
+    size_t changed = 0;
+    for (size_t i = 0; i < files.size(); i++) {
+        if (!updates[i].error.empty()) {
+            std::cerr << updates[i].error << "\n";
+        } else if (updates[i].changed) {
+            builder.set_file(files[i], updates[i].hash, std::move(updates[i].entries));
+            changed++;
+        }
     }
+    builder.write(index_path);
+    std::cerr << "index: " << changed << " of " << files.size() << " files reindexed\n";
 }
 
-// Print the collected functions in a table-like format
-void print_function_table(const std::vector<FunctionInfo>& functions) {
-    std::cout << "-------------------------------------------------------------\n";
-    std::cout << std::left << std::setw(30) << "Function Name" << std::setw(60) << "Declaration" << "\n";
-    std::cout << "-------------------------------------------------------------\n";
-    for (const auto& func : functions) {
-        std::cout << std::left << std::setw(30) << func.name << std::setw(60) << func.declaration << "\n";
-    }
-    std::cout << "-------------------------------------------------------------\n";
+static void print_records(const XrefIndex &index, uint32_t name) {
+    auto records = index.records(name);
+    for (const XrefRecord *record = records.first; record != records.second; ++record) {
+        std::cout << index.file_path(record->file) << ":" << record->start_row + 1 << ":" << record->start_column + 1
+                  << ": " << xref_kind_name(static_cast<XrefKind>(record->kind)) << " " << index.name(name);
+        if (record->container != UINT32_MAX) std::cout << " in " << index.name(record->container);
+        std::cout << "\n";
+    }
 }
 
+// Index mode: update the index from the operands, if any, then answer the
+// queries from the mapped file.
+static int run_index(const std::string &index_path, const std::vector<std::string> &operands, unsigned jobs,
+                     const std::string &lookup, const std::string &prefix, bool has_prefix) {
+    try {
+        if (!operands.empty()) update_index(index_path, operands, jobs);
+        if (lookup.empty() && !has_prefix) return 0;
+        XrefIndex index(index_path);
+        if (!lookup.empty()) {
+            uint32_t name = index.find(lookup);
+            if (name != UINT32_MAX) print_records(index, name);
+        }
+        if (has_prefix) {
+            std::pair<uint32_t, uint32_t> names = index.prefix(prefix);
+            for (uint32_t name = names.first; name < names.second; name++) print_records(index, name);
+        }
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
 
 int main(int argc, char **argv) {
-    if (argc < 2) {
-        std::cerr << "Usage: xrefparser <source.cpp>\n";
+    std::string cache_directory;
+    std::string stats_path;
+    std::string index_path;
+    std::string lookup;
+    std::string prefix;
+    bool has_prefix = false;
+    unsigned jobs = 0;
+    std::vector<std::string> operands;
+    bool bad_arguments = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--cache" && i + 1 < argc) {
+            cache_directory = argv[++i];
+        } else if (arg == "--stats" && i + 1 < argc) {
+            stats_path = argv[++i];
+        } else if (arg == "--index" && i + 1 < argc) {
+            index_path = argv[++i];
+        } else if (arg == "--lookup" && i + 1 < argc) {
+            lookup = argv[++i];
+        } else if (arg == "--prefix" && i + 1 < argc) {
+            prefix = argv[++i];
+            has_prefix = true;
+        } else if ((arg == "-j" || arg == "--jobs") && i + 1 < argc) {
+            bad_arguments |= !parse_worker_count(argv[++i], jobs);
+        } else {
+            operands.push_back(arg);
+        }
+    }
+    if (!index_path.empty() && !bad_arguments) {
+        return run_index(index_path, operands, jobs, lookup, prefix, has_prefix);
+    }
+    if (operands.size() != 1 || bad_arguments) {
+        std::cerr << "Usage: xrefparser [--cache dir] [--stats out.json|out.csv] <source.cpp>\n"
+                  << "       xrefparser --index file.xref [-j jobs] [--lookup name] [--prefix text] [<file|directory>...]\n";
+        return 1;
+    }
+    const char *path = operands[0].c_str();
+
+    Metrics metrics;
+    bool instrument = !stats_path.empty();
+    if (instrument) count_tree_sitter_allocations();
+    uint64_t run_start = monotonic_nanos();
+    MetricsScope scope(instrument ? &metrics : nullptr);
+
+    SourceFile source;
+    try {
+        PhaseTimer timer(phase_read);
+        source = SourceFile(path);
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << "\n";
         return 1;
     }
 
-    std::string source_code = read_file(argv[1]);
+    // A cached function table for these exact bytes skips the parse entirely.
+    AnalysisOptions options;
+    options.memory = false;
+    options.functions = true;
+    std::unique_ptr<ResultCache> cache;
+    std::string key;
+    AnalysisResult result;
+    if (!cache_directory.empty()) {
+        PhaseTimer timer(phase_read);
+        cache = std::make_unique<ResultCache>(cache_directory);
+        key = cache->key(source.text(), options);
+        metrics.cache_hit = cache->load(key, result);
+    }
+    if (!metrics.cache_hit) {
+        // Initialize Tree-sitter C++ parser
+        TSParser *parser = ts_parser_new();
+        ts_parser_set_language(parser, tree_sitter_cpp());
 
-    // Initialize Tree-sitter C++ parser
-    TSParser *parser = ts_parser_new();
-    ts_parser_set_language(parser, tree_sitter_cpp());
+        // Parse the source code into a syntax tree
+        metrics.bytes += source.text().size();
+        TSTree *tree;
+        {
+            PhaseTimer timer(phase_parse);
+            tree = parse_source(parser, nullptr, source.text());
+        }
+        if (!tree) {
+            std::cerr << "Error: could not parse " << path << "\n";
+            ts_parser_delete(parser);
+            return 1;
+        }
 
-    // Parse the source code into a syntax tree
-    TSTree *tree = ts_parser_parse_string(
-        parser,
-        nullptr,
-        source_code.c_str(),
-        source_code.length()
-    );
+        TSNode root = ts_tree_root_node(tree);
 
-    TSNode root = ts_tree_root_node(tree);
+        // Collect functions and cross-references
+        collect_functions(root, source.text(), result.functions);
+        if (cache) cache->store(key, result);
 
-    // Collect functions and cross-references
-    std::vector<FunctionInfo> functions;
-    collect_functions(root, source_code, functions);
+        // Clean up
+        ts_tree_delete(tree);
+        ts_parser_delete(parser);
+    }
 
     // Print the function table
-    print_function_table(functions);
-
-    // Clean up
-    ts_tree_delete(tree);
-    ts_parser_delete(parser);
+    {
+        PhaseTimer timer(phase_report);
+        print_function_table(result.functions);
+        std::cout.flush();
+    }
+    if (cache) {
+        std::cerr << "cache: " << cache->hits() << " hits, " << cache->misses() << " misses\n";
+    }
+    if (instrument) {
+        std::ofstream out(stats_path);
+        std::vector<std::string> paths = {path};
+        std::vector<Metrics> all = {metrics};
+        bool csv = stats_path.size() >= 4 && stats_path.compare(stats_path.size() - 4, 4, ".csv") == 0;
+        if (csv) {
+            write_metrics_csv(out, paths, all, monotonic_nanos() - run_start);
+        } else {
+            write_metrics_json(out, paths, all, monotonic_nanos() - run_start);
+        }
+    }
 
     return 0;
 }